@@ -1,19 +1,162 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0A00  // CopyFile2, FileIdBothDirectoryInfo and friends
+#endif
 #include <windows.h>
+#include <tlhelp32.h>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <functional>
-
-#define SLEEP_MSEC 1000
+#include <algorithm>
+#include <random>
+#include <map>
+#include <deque>
+
+// Upper bound for waiting on a post-condition (file visible, size, attributes)
+// that a network redirector may report late. Polling starts at
+// SETTLE_BACKOFF_MIN_MSEC and doubles up to SETTLE_BACKOFF_MAX_MSEC.
+#define SETTLE_TIMEOUT_MSEC 5000
+#define SETTLE_BACKOFF_MIN_MSEC 1
+#define SETTLE_BACKOFF_MAX_MSEC 128
+
+// Deadline for a whole test. A test still running after this long is reported
+// as TIMEOUT and abandoned so the rest of the suite can continue.
+#define TEST_TIMEOUT_MSEC 300000
+
+// HDR-style latency histograms count values below LATENCY_SUB_BUCKETS
+// nanoseconds exactly and larger ones with LATENCY_SUB_BUCKETS / 2 linear steps
+// per power of two, which bounds the relative error below 1%.
+#define LATENCY_SUB_BUCKETS 256
+
+// Failed steal rounds after which an idle tree walker thread sleeps instead of
+// yielding.
+#define TREE_WALK_SPINS 64
+
+// Completions dequeued per GetQueuedCompletionStatusEx call by the async I/O
+// engine's threads.
+#define ASYNC_IO_BATCH 64
+
+// Frames captured from a hung worker to name the API call it is blocked in.
+#define HANG_CAPTURE_MAX_FRAMES 64
 
 // Utils
 
+struct TestLogLine {
+    bool success;
+    std::wstring text;
+};
+
+// Outcome of one registered test. While a test runs, LogSuccess/LogFailure
+// append to the result owned by the calling worker instead of printing, so
+// output from concurrently running tests stays attributed to its test.
+struct TestResult {
+    std::wstring name;
+    std::vector<TestLogLine> lines;
+    int successes = 0;
+    int failures = 0;
+    double seconds = 0.0;
+    double settleSeconds = 0.0;  // Time spent in WaitUntil for post-conditions
+    int settleTimeouts = 0;      // Post-conditions that never held before the deadline
+    bool timedOut = false;       // Abandoned by the watchdog after TEST_TIMEOUT_MSEC
+};
+
+static thread_local TestResult* g_currentResult = nullptr;
+static DWORD g_settleTimeoutMsec = SETTLE_TIMEOUT_MSEC;
+static SRWLOCK g_consoleLock = SRWLOCK_INIT;
+
 void LogSuccess(const std::wstring& functionName, const std::wstring& details) {
-    std::wcout << L"[OK] " << functionName << L" " << details << std::endl;
+    std::wstring line = L"[OK] " + functionName + L" " + details;
+    if (g_currentResult) {
+        g_currentResult->lines.push_back({ true, line });
+        g_currentResult->successes++;
+        return;
+    }
+    AcquireSRWLockExclusive(&g_consoleLock);
+    std::wcout << line << std::endl;
+    ReleaseSRWLockExclusive(&g_consoleLock);
 }
 
 void LogFailure(const std::wstring& functionName, const std::wstring& message) {
-    std::wcerr << L"[FAIL] " << functionName << L": " << message << std::endl;
+    std::wstring line = L"[FAIL] " + functionName + L": " + message;
+    if (g_currentResult) {
+        g_currentResult->lines.push_back({ false, line });
+        g_currentResult->failures++;
+        return;
+    }
+    AcquireSRWLockExclusive(&g_consoleLock);
+    std::wcerr << line << std::endl;
+    ReleaseSRWLockExclusive(&g_consoleLock);
+}
+
+LONGLONG QueryCounter() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+double CounterToSeconds(LONGLONG ticks) {
+    static const LONGLONG frequency = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    return (double)ticks / (double)frequency;
+}
+
+ULONGLONG CounterToNanoseconds(LONGLONG ticks) {
+    return (ULONGLONG)(CounterToSeconds(ticks) * 1e9);
+}
+
+// Polls `condition` with exponential backoff until it holds or the settle
+// deadline passes. The time spent is charged to the running test, which makes
+// the target's metadata-visibility lag measurable instead of a fixed sleep.
+bool WaitUntil(const std::function<bool()>& condition) {
+    LONGLONG start = QueryCounter();
+    DWORD backoff = SETTLE_BACKOFF_MIN_MSEC;
+    bool satisfied = condition();
+
+    while (!satisfied) {
+        double elapsedMsec = CounterToSeconds(QueryCounter() - start) * 1000.0;
+        if (elapsedMsec >= g_settleTimeoutMsec)
+            break;
+        Sleep(std::min<DWORD>(backoff, (DWORD)(g_settleTimeoutMsec - elapsedMsec) + 1));
+        backoff = std::min<DWORD>(backoff * 2, SETTLE_BACKOFF_MAX_MSEC);
+        satisfied = condition();
+    }
+
+    if (g_currentResult) {
+        g_currentResult->settleSeconds += CounterToSeconds(QueryCounter() - start);
+        if (!satisfied)
+            g_currentResult->settleTimeouts++;
+    }
+    return satisfied;
+}
+
+bool FileIsVisible(const std::wstring& path) {
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileW(path.c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return false;
+    FindClose(hFind);
+    return true;
+}
+
+bool WaitForFileVisible(const std::wstring& path) {
+    return WaitUntil([&] { return FileIsVisible(path); });
+}
+
+bool WaitForFileGone(const std::wstring& path) {
+    return WaitUntil([&] { return !FileIsVisible(path); });
+}
+
+bool WaitForAttributes(const std::wstring& path, DWORD attributes) {
+    return WaitUntil([&] {
+        DWORD attrs = GetFileAttributesW(path.c_str());
+        return attrs != INVALID_FILE_ATTRIBUTES && (attrs & attributes) == attributes;
+    });
 }
 
 bool FileExistsAndSizeEquals(const std::wstring& filePath, DWORD expectedSize) {
@@ -26,6 +169,209 @@ bool FileExistsAndSizeEquals(const std::wstring& filePath, DWORD expectedSize) {
     return !(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && (actualSize == expectedSize);
 }
 
+bool WaitForFileSize(const std::wstring& filePath, DWORD expectedSize) {
+    return WaitUntil([&] { return FileExistsAndSizeEquals(filePath, expectedSize); });
+}
+
+// Deletes a directory and everything below it. Read-only entries are cleared
+// first; symbolic links and junctions are removed without following them.
+bool RemoveDirectoryTree(const std::wstring& path) {
+    std::wstring search = path + L"\\*";
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = FindFirstFileW(search.c_str(), &data);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0) continue;
+
+            std::wstring child = path + L"\\" + data.cFileName;
+            if (data.dwFileAttributes & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM))
+                SetFileAttributesW(child.c_str(), FILE_ATTRIBUTE_NORMAL);
+
+            if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                DeleteFileW(child.c_str());
+            else if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+                RemoveDirectoryW(child.c_str());
+            else
+                RemoveDirectoryTree(child);
+        } while (FindNextFileW(hFind, &data));
+        FindClose(hFind);
+    }
+
+    SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    return RemoveDirectoryW(path.c_str()) != FALSE;
+}
+
+// Parallel tree walker. Each thread owns a deque of directories still to be
+// listed: it pops its own work from the back, which keeps the walk depth first
+// and cache friendly, and steals from the front of other threads' deques, where
+// the largest unexplored subtrees sit. Entries are streamed to the visitor as
+// they are listed, concurrently from all threads; directory reparse points are
+// reported but not followed.
+typedef void (*TreeVisitor)(const std::wstring& parent, const WIN32_FIND_DATAW& entry, DWORD depth, void* context);
+
+struct TreeWalkStats {
+    ULONGLONG files = 0;
+    ULONGLONG directories = 0;
+    ULONGLONG errors = 0;  // Directories that could not be listed
+};
+
+struct TreeWalkItem {
+    std::wstring path;
+    DWORD depth;
+};
+
+struct TreeWalkQueue {
+    SRWLOCK lock = SRWLOCK_INIT;
+    std::deque<TreeWalkItem> items;
+};
+
+struct TreeWalker {
+    TreeVisitor visitor;
+    void* context;
+    std::vector<TreeWalkQueue> queues;
+    std::vector<TreeWalkStats> stats;
+    LONG volatile pending = 0;  // Directories queued or being listed
+    LONG volatile nextThread = 0;
+};
+
+bool TakeTreeWalkItem(TreeWalker& walker, DWORD self, TreeWalkItem& item) {
+    for (DWORD i = 0; i < walker.queues.size(); ++i) {
+        DWORD victim = (self + i) % (DWORD)walker.queues.size();
+        TreeWalkQueue& queue = walker.queues[victim];
+        AcquireSRWLockExclusive(&queue.lock);
+        bool found = !queue.items.empty();
+        if (found && victim == self) {
+            item = std::move(queue.items.back());
+            queue.items.pop_back();
+        } else if (found) {
+            item = std::move(queue.items.front());
+            queue.items.pop_front();
+        }
+        ReleaseSRWLockExclusive(&queue.lock);
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+void ListTreeWalkItem(TreeWalker& walker, DWORD self, const TreeWalkItem& item) {
+    TreeWalkStats& stats = walker.stats[self];
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = FindFirstFileExW((item.path + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                    nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        stats.errors++;
+        return;
+    }
+    do {
+        if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0)
+            continue;
+        walker.visitor(item.path, data, item.depth + 1, walker.context);
+
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            stats.files++;
+            continue;
+        }
+        stats.directories++;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+            continue;
+
+        InterlockedIncrement(&walker.pending);
+        TreeWalkQueue& queue = walker.queues[self];
+        AcquireSRWLockExclusive(&queue.lock);
+        queue.items.push_back({ item.path + L"\\" + data.cFileName, item.depth + 1 });
+        ReleaseSRWLockExclusive(&queue.lock);
+    } while (FindNextFileW(hFind, &data));
+    FindClose(hFind);
+}
+
+static DWORD WINAPI TreeWalkThread(LPVOID param) {
+    TreeWalker& walker = *static_cast<TreeWalker*>(param);
+    DWORD self = (DWORD)InterlockedIncrement(&walker.nextThread) - 1;
+    DWORD idleRounds = 0;
+    TreeWalkItem item;
+    for (;;) {
+        if (TakeTreeWalkItem(walker, self, item)) {
+            ListTreeWalkItem(walker, self, item);
+            InterlockedDecrement(&walker.pending);
+            idleRounds = 0;
+        } else if (InterlockedCompareExchange(&walker.pending, 0, 0) == 0) {
+            return 0;
+        } else if (++idleRounds < TREE_WALK_SPINS) {
+            SwitchToThread();
+        } else {
+            Sleep(1);
+        }
+    }
+}
+
+// Visits every entry below `root` from `threads` threads and returns the
+// totals. The root itself is not passed to the visitor.
+TreeWalkStats WalkTree(const std::wstring& root, DWORD threads, TreeVisitor visitor, void* context) {
+    threads = std::max<DWORD>(1, threads);
+    TreeWalker walker;
+    walker.visitor = visitor;
+    walker.context = context;
+    walker.queues = std::vector<TreeWalkQueue>(threads);
+    walker.stats.assign(threads, TreeWalkStats());
+    walker.pending = 1;
+    walker.queues[0].items.push_back({ root, 0 });
+
+    std::vector<HANDLE> handles;
+    for (DWORD i = 1; i < threads; ++i) {
+        HANDLE t = CreateThread(nullptr, 0, TreeWalkThread, &walker, 0, nullptr);
+        if (t != nullptr)
+            handles.push_back(t);
+    }
+    // The calling thread is always one of the walkers.
+    TreeWalkThread(&walker);
+    for (HANDLE t : handles) {
+        WaitForSingleObject(t, INFINITE);
+        CloseHandle(t);
+    }
+
+    TreeWalkStats total;
+    for (const auto& stats : walker.stats) {
+        total.files += stats.files;
+        total.directories += stats.directories;
+        total.errors += stats.errors;
+    }
+    return total;
+}
+
+struct TreeRemoval {
+    SRWLOCK lock = SRWLOCK_INIT;
+    std::vector<TreeWalkItem> directories;
+};
+
+static void RemoveTreeEntry(const std::wstring& parent, const WIN32_FIND_DATAW& entry, DWORD depth, void* context) {
+    std::wstring path = parent + L"\\" + entry.cFileName;
+    if (entry.dwFileAttributes & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM))
+        SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        DeleteFileW(path.c_str());
+        return;
+    }
+    TreeRemoval& removal = *static_cast<TreeRemoval*>(context);
+    AcquireSRWLockExclusive(&removal.lock);
+    removal.directories.push_back({ path, depth });
+    ReleaseSRWLockExclusive(&removal.lock);
+}
+
+// RemoveDirectoryTree for large fixtures: files are deleted by the parallel
+// walker as they are found, then directories are removed deepest first.
+bool RemoveDirectoryTreeParallel(const std::wstring& path, DWORD threads) {
+    TreeRemoval removal;
+    WalkTree(path, threads, RemoveTreeEntry, &removal);
+    std::sort(removal.directories.begin(), removal.directories.end(),
+              [](const TreeWalkItem& a, const TreeWalkItem& b) { return a.depth > b.depth; });
+    for (const auto& directory : removal.directories)
+        RemoveDirectoryW(directory.path.c_str());
+
+    SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    return RemoveDirectoryW(path.c_str()) != FALSE;
+}
+
 void WriteDummyContent(const std::wstring& filePath) {
     HANDLE h = CreateFileW(filePath.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, 0, nullptr);
     if (h != INVALID_HANDLE_VALUE) {
@@ -36,11 +382,210 @@ void WriteDummyContent(const std::wstring& filePath) {
     }
 }
 
+// Space of the volume holding a path. The root comes from GetVolumePathNameW,
+// so a target on Z: or a mounted folder is measured rather than the system
+// drive.
+struct VolumeSpace {
+    std::wstring root;
+    ULONGLONG freeBytes = 0;
+    ULONGLONG totalBytes = 0;
+    DWORD clusterSize = 0;
+    DWORD sectorSize = 0;
+};
+
+bool QueryVolumeSpace(const std::wstring& path, VolumeSpace& space) {
+    std::vector<wchar_t> root(path.size() + 2);
+    if (!GetVolumePathNameW(path.c_str(), root.data(), (DWORD)root.size()))
+        return false;
+    space.root = root.data();
+
+    ULARGE_INTEGER available, total, totalFree;
+    if (!GetDiskFreeSpaceExW(space.root.c_str(), &available, &total, &totalFree))
+        return false;
+    space.freeBytes = totalFree.QuadPart;
+    space.totalBytes = total.QuadPart;
+
+    DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+    if (GetDiskFreeSpaceW(space.root.c_str(), &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters)) {
+        space.clusterSize = sectorsPerCluster * bytesPerSector;
+        space.sectorSize = bytesPerSector;
+    }
+    return true;
+}
+
+// Asynchronous I/O engine: a completion port serviced by a few threads, a fixed
+// pool of OVERLAPPED contexts and one VirtualAlloc region carved into per-context
+// buffers. Each buffer starts on a page boundary (the carving stride is the
+// buffer size rounded up to a whole page), so sizes that are a multiple of
+// the sector size satisfy FILE_FLAG_NO_BUFFERING. The callback runs on a completion
+// thread and may resubmit its context to keep the queue full.
+struct AsyncIoEngine;
+
+struct AsyncIoContext {
+    OVERLAPPED overlapped;  // First member: completions hand this pointer back
+    AsyncIoEngine* engine;
+    HANDLE file;
+    BYTE* buffer;
+    LONGLONG submitted;     // QueryCounter() when the operation was issued
+    void* user;
+};
+
+typedef void (*AsyncIoCallback)(AsyncIoContext* context, DWORD error, DWORD bytes, DWORD thread);
+
+struct AsyncIoEngine {
+    HANDLE port = nullptr;
+    HANDLE idle = nullptr;  // Auto-reset, set when the last operation in flight completes
+    AsyncIoCallback callback = nullptr;
+    std::vector<AsyncIoContext> contexts;
+    std::vector<AsyncIoContext*> freeContexts;
+    SRWLOCK freeLock = SRWLOCK_INIT;
+    BYTE* buffers = nullptr;
+    DWORD bufferSize = 0;
+    std::vector<HANDLE> threads;
+    LONG volatile inFlight = 0;
+    LONG volatile startedThreads = 0;
+};
+
+static DWORD WINAPI AsyncIoCompletionThread(LPVOID param) {
+    AsyncIoEngine* engine = static_cast<AsyncIoEngine*>(param);
+    DWORD index = (DWORD)InterlockedIncrement(&engine->startedThreads) - 1;
+    OVERLAPPED_ENTRY entries[ASYNC_IO_BATCH];
+    for (;;) {
+        ULONG removed = 0;
+        if (!GetQueuedCompletionStatusEx(engine->port, entries, ASYNC_IO_BATCH, &removed, INFINITE, FALSE))
+            return 0;
+
+        bool stop = false;
+        for (ULONG i = 0; i < removed; ++i) {
+            if (entries[i].lpOverlapped == nullptr) {
+                // Stop packet. Hand any extra ones on to the other threads.
+                if (stop)
+                    PostQueuedCompletionStatus(engine->port, 0, 0, nullptr);
+                stop = true;
+                continue;
+            }
+
+            AsyncIoContext* context = reinterpret_cast<AsyncIoContext*>(entries[i].lpOverlapped);
+            DWORD bytes = 0, error = ERROR_SUCCESS;
+            if (!GetOverlappedResult(context->file, &context->overlapped, &bytes, FALSE))
+                error = GetLastError();
+            engine->callback(context, error, bytes, index);
+
+            if (InterlockedDecrement(&engine->inFlight) == 0)
+                SetEvent(engine->idle);
+        }
+        if (stop)
+            return 0;
+    }
+}
+
+bool StartAsyncIoEngine(AsyncIoEngine& engine, DWORD contextCount, DWORD bufferSize, DWORD threadCount,
+                        AsyncIoCallback callback) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    SIZE_T stride = ((SIZE_T)bufferSize + si.dwPageSize - 1) / si.dwPageSize * si.dwPageSize;
+
+    engine.callback = callback;
+    engine.bufferSize = bufferSize;
+    engine.port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, threadCount);
+    engine.idle = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    engine.buffers = (BYTE*)VirtualAlloc(nullptr, (SIZE_T)contextCount * stride, MEM_COMMIT | MEM_RESERVE,
+                                         PAGE_READWRITE);
+    if (engine.port == nullptr || engine.idle == nullptr || (engine.buffers == nullptr && bufferSize != 0))
+        return false;
+
+    engine.contexts.assign(contextCount, AsyncIoContext());
+    for (DWORD i = 0; i < contextCount; ++i) {
+        engine.contexts[i].engine = &engine;
+        engine.contexts[i].buffer = engine.buffers + (SIZE_T)i * stride;
+        engine.freeContexts.push_back(&engine.contexts[i]);
+    }
+
+    for (DWORD i = 0; i < threadCount; ++i) {
+        HANDLE t = CreateThread(nullptr, 0, AsyncIoCompletionThread, &engine, 0, nullptr);
+        if (t == nullptr)
+            return false;
+        engine.threads.push_back(t);
+    }
+    return true;
+}
+
+// Binds a handle opened with FILE_FLAG_OVERLAPPED to the engine. A handle can
+// only ever be bound to one completion port.
+bool AssociateAsyncIoFile(AsyncIoEngine& engine, HANDLE file) {
+    return CreateIoCompletionPort(file, engine.port, 0, 0) == engine.port;
+}
+
+AsyncIoContext* AcquireAsyncIoContext(AsyncIoEngine& engine) {
+    AsyncIoContext* context = nullptr;
+    AcquireSRWLockExclusive(&engine.freeLock);
+    if (!engine.freeContexts.empty()) {
+        context = engine.freeContexts.back();
+        engine.freeContexts.pop_back();
+    }
+    ReleaseSRWLockExclusive(&engine.freeLock);
+    return context;
+}
+
+void ReleaseAsyncIoContext(AsyncIoContext* context) {
+    AsyncIoEngine& engine = *context->engine;
+    AcquireSRWLockExclusive(&engine.freeLock);
+    engine.freeContexts.push_back(context);
+    ReleaseSRWLockExclusive(&engine.freeLock);
+}
+
+// Issues a read or write of `length` bytes at `offset` using the context's
+// buffer. On failure nothing is in flight and GetLastError() tells why.
+bool SubmitAsyncIo(AsyncIoContext* context, HANDLE file, bool write, ULONGLONG offset, DWORD length) {
+    AsyncIoEngine& engine = *context->engine;
+    context->file = file;
+    context->overlapped = OVERLAPPED();
+    context->overlapped.Offset = (DWORD)offset;
+    context->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    context->submitted = QueryCounter();
+
+    // Count first: the completion may be dequeued before the call returns.
+    InterlockedIncrement(&engine.inFlight);
+    BOOL ok = write ? WriteFile(file, context->buffer, length, nullptr, &context->overlapped)
+                    : ReadFile(file, context->buffer, length, nullptr, &context->overlapped);
+    if (!ok && GetLastError() != ERROR_IO_PENDING) {
+        DWORD error = GetLastError();
+        if (InterlockedDecrement(&engine.inFlight) == 0)
+            SetEvent(engine.idle);
+        SetLastError(error);
+        return false;
+    }
+    return true;
+}
+
+void WaitAsyncIoIdle(AsyncIoEngine& engine) {
+    while (InterlockedCompareExchange(&engine.inFlight, 0, 0) != 0)
+        WaitForSingleObject(engine.idle, INFINITE);
+}
+
+// Waits for outstanding operations, then shuts the completion threads down.
+void StopAsyncIoEngine(AsyncIoEngine& engine) {
+    WaitAsyncIoIdle(engine);
+    for (size_t i = 0; i < engine.threads.size(); ++i)
+        PostQueuedCompletionStatus(engine.port, 0, 0, nullptr);
+    for (HANDLE t : engine.threads) {
+        WaitForSingleObject(t, INFINITE);
+        CloseHandle(t);
+    }
+    engine.threads.clear();
+    if (engine.buffers != nullptr)
+        VirtualFree(engine.buffers, 0, MEM_RELEASE);
+    if (engine.port != nullptr)
+        CloseHandle(engine.port);
+    if (engine.idle != nullptr)
+        CloseHandle(engine.idle);
+    engine.buffers = nullptr;
+    engine.port = engine.idle = nullptr;
+}
+
 // Tests
 
 void CreateFileWCreateAlways(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-
     std::wstring path = dir + L"\\CreateAlways.txt";
     WriteDummyContent(path);
 
@@ -51,14 +596,13 @@ void CreateFileWCreateAlways(const std::wstring& dir) {
     }
     CloseHandle(h);
 
-    if (FileExistsAndSizeEquals(path, 0))
+    if (WaitForFileSize(path, 0))
         LogSuccess(L"CreateFileW", L"DesiredAccess=GENERIC_WRITE CreationDisposition=CREATE_ALWAYS Flags=FILE_ATTRIBUTE_NORMAL");
     else
         LogFailure(L"CreateFileW", L"Expected file to be truncated");
 }
 
 void CreateFileWCreateNew(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\CreateNew.txt";
     DeleteFileW(path.c_str());
 
@@ -69,14 +613,13 @@ void CreateFileWCreateNew(const std::wstring& dir) {
     }
     CloseHandle(h);
 
-    if (FileExistsAndSizeEquals(path.c_str(), 0))
+    if (WaitForFileSize(path, 0))
         LogSuccess(L"CreateFileW", L"DesiredAccess=GENERIC_WRITE CreationDisposition=CREATE_NEW Flags=FILE_ATTRIBUTE_NORMAL");
     else
         LogFailure(L"CreateFileW", L"File was not created as expected");
 }
 
 void CreateFileWTruncateExisting(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\TruncateExisting.txt";
     WriteDummyContent(path);
 
@@ -87,14 +630,13 @@ void CreateFileWTruncateExisting(const std::wstring& dir) {
     }
     CloseHandle(h);
 
-    if (FileExistsAndSizeEquals(path.c_str(), 0))
+    if (WaitForFileSize(path, 0))
         LogSuccess(L"CreateFileW", L"DesiredAccess=GENERIC_WRITE CreationDisposition=TRUNCATE_EXISTING Flags=FILE_ATTRIBUTE_NORMAL");
     else
         LogFailure(L"CreateFileW", L"Expected file to be truncated but size was not zero");
 }
 
 void CreateFileWOpenExisting(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\OpenExisting.txt";
     WriteDummyContent(path);
 
@@ -105,14 +647,13 @@ void CreateFileWOpenExisting(const std::wstring& dir) {
     }
     CloseHandle(h);
 
-    if (FileExistsAndSizeEquals(path.c_str(), 4))
+    if (WaitForFileSize(path, 4))
         LogSuccess(L"CreateFileW", L"DesiredAccess=GENERIC_READ CreationDisposition=OPEN_EXISTING Flags=FILE_ATTRIBUTE_NORMAL");
     else
         LogFailure(L"CreateFileW", L"File should retain dummy content");
 }
 
 void CreateFileWOpenAlways(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\OpenAlways.txt";
     DeleteFileW(path.c_str());
 
@@ -123,14 +664,13 @@ void CreateFileWOpenAlways(const std::wstring& dir) {
     }
     CloseHandle(h);
 
-    if (FileExistsAndSizeEquals(path.c_str(), 0))
+    if (WaitForFileSize(path, 0))
         LogSuccess(L"CreateFileW", L"DesiredAccess=GENERIC_WRITE CreationDisposition=OPEN_ALWAYS Flags=FILE_ATTRIBUTE_NORMAL");
     else
         LogFailure(L"CreateFileW", L"File should have been created");
 }
 
 void CreateFileWReadWriteAccess(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\ReadWriteAccess.txt";
     DeleteFileW(path.c_str());
 
@@ -145,14 +685,13 @@ void CreateFileWReadWriteAccess(const std::wstring& dir) {
     BOOL writeOK = WriteFile(h, text, 5, &written, nullptr);
     CloseHandle(h);
 
-    if (writeOK && FileExistsAndSizeEquals(path.c_str(), 5))
+    if (writeOK && WaitForFileSize(path, 5))
         LogSuccess(L"CreateFileW", L"DesiredAccess=GENERIC_READ|GENERIC_WRITE CreationDisposition=CREATE_ALWAYS Flags=FILE_ATTRIBUTE_NORMAL");
     else
         LogFailure(L"CreateFileW", L"File was not written correctly with read/write access");
 }
 
 void CreateSymbolicLinkWFileLink(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring target = dir + L"\\CreateSymbolicLinkWFileLink_target.txt";
     std::wstring link = dir + L"\\CreateSymbolicLinkWFileLink_symlink.txt";
 
@@ -176,6 +715,7 @@ void CreateSymbolicLinkWFileLink(const std::wstring& dir) {
     }
 
     // Verify that link exists and is a reparse point
+    WaitForFileVisible(link);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(link.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE && (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
@@ -187,7 +727,6 @@ void CreateSymbolicLinkWFileLink(const std::wstring& dir) {
 }
 
 void CreateSymbolicLinkWDirectoryLink(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring targetDir = dir + L"\\CreateSymbolicLinkWDirectoryLink_target";
     std::wstring linkDir = dir + L"\\CreateSymbolicLinkWDirectoryLink_symlink";
 
@@ -203,6 +742,7 @@ void CreateSymbolicLinkWDirectoryLink(const std::wstring& dir) {
     }
 
     // Verify reparse point
+    WaitForFileVisible(linkDir);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(linkDir.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE && (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
@@ -214,7 +754,6 @@ void CreateSymbolicLinkWDirectoryLink(const std::wstring& dir) {
 }
 
 void CreateHardLinkWBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring original = dir + L"\\CreateHardLinkWBasic_original.txt";
     std::wstring link = dir + L"\\CreateHardLinkWBasic_link.txt";
 
@@ -262,7 +801,6 @@ void CreateHardLinkWBasic(const std::wstring& dir) {
 }
 
 void CreateHardLinkWTargetMissing(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring missing = dir + L"\\CreateHardLinkWTargetMissing_missing.txt";
     std::wstring link = dir + L"\\CreateHardLinkWTargetMissing_link.txt";
 
@@ -283,7 +821,6 @@ void CreateHardLinkWTargetMissing(const std::wstring& dir) {
 }
 
 void CreateHardLinkWAlreadyExists(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring original = dir + L"\\CreateHardLinkWAlreadyExists_original.txt";
     std::wstring link = dir + L"\\CreateHardLinkWAlreadyExists_existing.txt";
 
@@ -311,7 +848,6 @@ void CreateHardLinkWAlreadyExists(const std::wstring& dir) {
 }
 
 void CreateHardLinkWModifyLinkReflectsInOriginal(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring original = dir + L"\\CreateHardLinkWModifyLinkReflectsInOriginal_original.txt";
     std::wstring link = dir + L"\\CreateHardLinkWModifyLinkReflectsInOriginal_link.txt";
 
@@ -364,7 +900,6 @@ void CreateHardLinkWModifyLinkReflectsInOriginal(const std::wstring& dir) {
 }
 
 void CreateDirectoryWBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\CreateDirectoryWBasic";
 
     // Cleanup
@@ -372,6 +907,7 @@ void CreateDirectoryWBasic(const std::wstring& dir) {
 
     // Create directory
     if (CreateDirectoryW(path.c_str(), nullptr)) {
+        WaitForFileVisible(path);
         WIN32_FIND_DATAW findData;
         HANDLE hFind = FindFirstFileW(path.c_str(), &findData);
         if (hFind != INVALID_HANDLE_VALUE && (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
@@ -386,7 +922,6 @@ void CreateDirectoryWBasic(const std::wstring& dir) {
 }
 
 void CreateDirectoryWAlreadyExists(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\CreateDirectoryWAlreadyExists";
 
     // Ensure it exists
@@ -405,7 +940,6 @@ void CreateDirectoryWAlreadyExists(const std::wstring& dir) {
 }
 
 void CreateDirectoryWWithSubdirectories(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring root = dir + L"\\CreateDirectoryWWithSubdirectories";
     std::wstring sub1 = dir + L"\\CreateDirectoryWWithSubdirectories\\sub1";
     std::wstring sub2 = dir + L"\\CreateDirectoryWWithSubdirectories\\sub1\\sub2";
@@ -418,6 +952,7 @@ void CreateDirectoryWWithSubdirectories(const std::wstring& dir) {
     if (CreateDirectoryW(root.c_str(), nullptr) &&
         CreateDirectoryW(sub1.c_str(), nullptr) &&
         CreateDirectoryW(sub2.c_str(), nullptr)) {
+        WaitForFileVisible(sub2);
         WIN32_FIND_DATAW data;
         HANDLE hFind = FindFirstFileW(sub2.c_str(), &data);
         if (hFind != INVALID_HANDLE_VALUE && (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
@@ -432,7 +967,6 @@ void CreateDirectoryWWithSubdirectories(const std::wstring& dir) {
 }
 
 void CreateDirectoryWInvalidPath(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring invalidPath = dir + L"?:\\invalid\\path";
 
     if (!CreateDirectoryW(invalidPath.c_str(), nullptr)) {
@@ -444,12 +978,12 @@ void CreateDirectoryWInvalidPath(const std::wstring& dir) {
 }
 
 void CreateDirectoryWRelativePath(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    std::wstring path = dir + L".\\CreateDirectoryWRelativePath";
+    std::wstring path = dir + L"\\.\\CreateDirectoryWRelativePath";
 
     RemoveDirectoryW(path.c_str());
 
     if (CreateDirectoryW(path.c_str(), nullptr)) {
+        WaitForFileVisible(path);
         WIN32_FIND_DATAW findData;
         HANDLE hFind = FindFirstFileW(path.c_str(), &findData);
         if (hFind != INVALID_HANDLE_VALUE && (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
@@ -464,7 +998,6 @@ void CreateDirectoryWRelativePath(const std::wstring& dir) {
 }
 
 void CopyFileWBasicCopy(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring src = dir + L"\\CopyFileWBasicCopy_source.txt";
     std::wstring dst = dir + L"\\CopyFileWBasicCopy_dest.txt";
 
@@ -488,6 +1021,7 @@ void CopyFileWBasicCopy(const std::wstring& dir) {
         return;
     }
 
+    WaitForFileVisible(dst);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(dst.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE) {
@@ -499,7 +1033,6 @@ void CopyFileWBasicCopy(const std::wstring& dir) {
 }
 
 void CopyFileWFailIfExists(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring src = dir + L"\\CopyFileWFailIfExists_source.txt";
     std::wstring dst = dir + L"\\CopyFileWFailIfExists_dest.txt";
 
@@ -530,7 +1063,6 @@ void CopyFileWFailIfExists(const std::wstring& dir) {
 }
 
 void CopyFileWOverwriteAllowed(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring src = dir + L"\\CopyFileWOverwriteAllowed_source.txt";
     std::wstring dst = dir + L"\\CopyFileWOverwriteAllowed_dest.txt";
 
@@ -559,6 +1091,7 @@ void CopyFileWOverwriteAllowed(const std::wstring& dir) {
     }
 
     // Verify content was updated (length = 1)
+    WaitForFileSize(dst, 1);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(dst.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE && findData.nFileSizeLow == 1) {
@@ -570,7 +1103,6 @@ void CopyFileWOverwriteAllowed(const std::wstring& dir) {
 }
 
 void CopyFileWSourceMissing(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring src = dir + L"\\CopyFileWSourceMissing_missing_source.txt";
     std::wstring dst = dir + L"\\CopyFileWSourceMissing_output.txt";
 
@@ -586,7 +1118,6 @@ void CopyFileWSourceMissing(const std::wstring& dir) {
 }
 
 void CopyFileWSubdirToParent(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring base = dir + L"\\CopyFileWSubdirToParent";
     std::wstring subdir = base + L"\\sub";
     std::wstring src = subdir + L"\\file.txt";
@@ -609,7 +1140,7 @@ void CopyFileWSubdirToParent(const std::wstring& dir) {
 
     // Perform copy
     BOOL result = CopyFileW(src.c_str(), dst.c_str(), TRUE);
-    if (result && FileExistsAndSizeEquals(dst, 11)) {
+    if (result && WaitForFileSize(dst, 11)) {
         LogSuccess(L"CopyFileW", L"Copied file from subdirectory to parent directory");
     } else {
         LogFailure(L"CopyFileW", L"Failed to copy from subdirectory to parent");
@@ -617,7 +1148,6 @@ void CopyFileWSubdirToParent(const std::wstring& dir) {
 }
 
 void CopyFileWParentToSubdir(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring base = dir + L"\\CopyFileWParentToSubdir";
     std::wstring subdir = base + L"\\child";
     std::wstring src = base + L"\\file.txt";
@@ -640,7 +1170,7 @@ void CopyFileWParentToSubdir(const std::wstring& dir) {
 
     // Perform copy
     BOOL result = CopyFileW(src.c_str(), dst.c_str(), TRUE);
-    if (result && FileExistsAndSizeEquals(dst, 10)) {
+    if (result && WaitForFileSize(dst, 10)) {
         LogSuccess(L"CopyFileW", L"Copied file from parent directory into subdirectory");
     } else {
         LogFailure(L"CopyFileW", L"Failed to copy from parent to subdirectory");
@@ -648,7 +1178,6 @@ void CopyFileWParentToSubdir(const std::wstring& dir) {
 }
 
 void CopyFileWFromSymbolicLink(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring target = dir + L"\\CopyFileWFromSymbolicLink_target.txt";
     std::wstring symlink = dir + L"\\CopyFileWFromSymbolicLink_symlink.txt";
     std::wstring copyDest = dir + L"\\CopyFileWFromSymbolicLink_copy.txt";
@@ -682,6 +1211,7 @@ void CopyFileWFromSymbolicLink(const std::wstring& dir) {
     }
 
     // Validate copy exists and is not a reparse point (i.e. not a symlink)
+    WaitForFileVisible(copyDest);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(copyDest.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE) {
@@ -698,7 +1228,6 @@ void CopyFileWFromSymbolicLink(const std::wstring& dir) {
 }
 
 void MoveFileWRenameSameDirectory(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring original = dir + L"\\MoveFileWRenameSameDirectory_original.txt";
     std::wstring renamed = dir + L"\\MoveFileWRenameSameDirectory_renamed.txt";
 
@@ -714,6 +1243,7 @@ void MoveFileWRenameSameDirectory(const std::wstring& dir) {
 
     // Perform rename
     if (MoveFileW(original.c_str(), renamed.c_str())) {
+        WaitForFileVisible(renamed);
         WIN32_FIND_DATAW findData;
         HANDLE hFind = FindFirstFileW(renamed.c_str(), &findData);
         if (hFind != INVALID_HANDLE_VALUE) {
@@ -728,7 +1258,6 @@ void MoveFileWRenameSameDirectory(const std::wstring& dir) {
 }
 
 void MoveFileWIntoSubdirectory(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring subdir = dir + L"\\MoveFileWIntoSubdirectory_dir";
     std::wstring original = dir + L"\\MoveFileWIntoSubdirectory.txt";
     std::wstring destination = subdir + L"\\moved.txt";
@@ -747,6 +1276,7 @@ void MoveFileWIntoSubdirectory(const std::wstring& dir) {
 
     // Perform move
     if (MoveFileW(original.c_str(), destination.c_str())) {
+        WaitForFileVisible(destination);
         WIN32_FIND_DATAW findData;
         HANDLE hFind = FindFirstFileW(destination.c_str(), &findData);
         if (hFind != INVALID_HANDLE_VALUE) {
@@ -761,7 +1291,6 @@ void MoveFileWIntoSubdirectory(const std::wstring& dir) {
 }
 
 void MoveFileWDestinationExists(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring src = dir + L"\\MoveFileWDestinationExists_src.txt";
     std::wstring dst = dir + L"\\MoveFileWDestinationExists_dst.txt";
 
@@ -786,7 +1315,6 @@ void MoveFileWDestinationExists(const std::wstring& dir) {
 }
 
 void MoveFileWSymbolicLinkItself(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring target = dir + L"\\MoveFileWSymbolicLinkItself_target.txt";
     std::wstring link = dir + L"\\MoveFileWSymbolicLinkItself_symlink.txt";
     std::wstring moved = dir + L"\\MoveFileWSymbolicLinkItself_symlink_moved.txt";
@@ -815,6 +1343,7 @@ void MoveFileWSymbolicLinkItself(const std::wstring& dir) {
     }
 
     // Validate moved symlink
+    WaitForFileVisible(moved);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(moved.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE && (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
@@ -826,7 +1355,6 @@ void MoveFileWSymbolicLinkItself(const std::wstring& dir) {
 }
 
 void MoveFileWFromSubdirectoryToParent(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring base = dir + L"\\MoveFileWFromSubdirectoryToParent";
     std::wstring subdir = base + L"\\sub";
     std::wstring src = subdir + L"\\file.txt";
@@ -846,6 +1374,7 @@ void MoveFileWFromSubdirectoryToParent(const std::wstring& dir) {
 
     // Move file up one level
     if (MoveFileW(src.c_str(), dst.c_str())) {
+        WaitForFileVisible(dst);
         WIN32_FIND_DATAW findData;
         HANDLE hFind = FindFirstFileW(dst.c_str(), &findData);
         if (hFind != INVALID_HANDLE_VALUE) {
@@ -860,7 +1389,6 @@ void MoveFileWFromSubdirectoryToParent(const std::wstring& dir) {
 }
 
 void MoveFileWDirectoryMoveBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring srcDir = dir + L"\\MoveFileWDirectoryMoveBasic_src";
     std::wstring dstDir = dir + L"\\MoveFileWDirectoryMoveBasic_dst";
     std::wstring nestedFile = srcDir + L"\\nested.txt";
@@ -879,6 +1407,7 @@ void MoveFileWDirectoryMoveBasic(const std::wstring& dir) {
 
     // Execute
     if (MoveFileW(srcDir.c_str(), dstDir.c_str())) {
+        WaitForFileVisible(expectedFile);
         HANDLE hVerify = CreateFileW(expectedFile.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
         if (hVerify != INVALID_HANDLE_VALUE) {
             CloseHandle(hVerify);
@@ -892,7 +1421,6 @@ void MoveFileWDirectoryMoveBasic(const std::wstring& dir) {
 }
 
 void MoveFileWDirectoryRenameInPlace(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring original = dir + L"\\MoveFileWDirectoryRenameInPlace_original";
     std::wstring renamed = dir + L"\\MoveFileWDirectoryRenameInPlace_renamed";
 
@@ -900,6 +1428,7 @@ void MoveFileWDirectoryRenameInPlace(const std::wstring& dir) {
     RemoveDirectoryW(renamed.c_str());
 
     if (MoveFileW(original.c_str(), renamed.c_str())) {
+        WaitForFileVisible(renamed);
         WIN32_FIND_DATAW data;
         HANDLE h = FindFirstFileW(renamed.c_str(), &data);
         if (h != INVALID_HANDLE_VALUE) {
@@ -914,7 +1443,6 @@ void MoveFileWDirectoryRenameInPlace(const std::wstring& dir) {
 }
 
 void MoveFileWDirectoryIntoSubdirectory(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring parent = dir + L"\\MoveFileWDirectoryIntoSubdirectory_parent";
     std::wstring child = parent + L"\\sub";
 
@@ -931,7 +1459,6 @@ void MoveFileWDirectoryIntoSubdirectory(const std::wstring& dir) {
 }
 
 void MoveFileWDirectoryOverwriteExisting(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring srcDir = dir + L"\\MoveFileWDirectoryOverwriteExisting_src";
     std::wstring dstDir = dir + L"\\MoveFileWDirectoryOverwriteExisting_dst";
 
@@ -947,7 +1474,6 @@ void MoveFileWDirectoryOverwriteExisting(const std::wstring& dir) {
 }
 
 void DeleteFileWBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\DeleteFileWBasic.txt";
 
     // Setup: create file
@@ -960,6 +1486,7 @@ void DeleteFileWBasic(const std::wstring& dir) {
 
     // Attempt delete
     if (DeleteFileW(path.c_str())) {
+        WaitForFileGone(path);
         WIN32_FIND_DATAW data;
         HANDLE hFind = FindFirstFileW(path.c_str(), &data);
         if (hFind == INVALID_HANDLE_VALUE) {
@@ -974,7 +1501,6 @@ void DeleteFileWBasic(const std::wstring& dir) {
 }
 
 void DeleteFileWNotExists(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\DeleteFileWNotExists.txt";
 
     // Ensure file doesn't exist
@@ -993,7 +1519,6 @@ void DeleteFileWNotExists(const std::wstring& dir) {
 }
 
 void DeleteFileWReadOnlyFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\DeleteFileWReadOnlyFile.txt";
 
     // Setup
@@ -1022,7 +1547,6 @@ void DeleteFileWReadOnlyFile(const std::wstring& dir) {
 }
 
 void DeleteFileWOnDirectory(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\DeleteFileWOnDirectory_testdir";
 
     // Setup
@@ -1044,8 +1568,7 @@ void DeleteFileWOnDirectory(const std::wstring& dir) {
 }
 
 void DeleteFileWRelativePath(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    std::wstring path = dir + L".\\DeleteFileWRelativePath.txt";
+    std::wstring path = dir + L"\\.\\DeleteFileWRelativePath.txt";
 
     // Setup
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
@@ -1056,6 +1579,7 @@ void DeleteFileWRelativePath(const std::wstring& dir) {
     CloseHandle(h);
 
     if (DeleteFileW(path.c_str())) {
+        WaitForFileGone(path);
         WIN32_FIND_DATAW data;
         HANDLE hFind = FindFirstFileW(path.c_str(), &data);
         if (hFind == INVALID_HANDLE_VALUE) {
@@ -1070,7 +1594,6 @@ void DeleteFileWRelativePath(const std::wstring& dir) {
 }
 
 void DeleteFileWInSubdirectory(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring ndir = dir + L"\\DeleteFileWInSubdirectory_dir";
     std::wstring file = dir + L"\\DeleteFileWInSubdirectory_dir\\nested.txt";
 
@@ -1086,6 +1609,7 @@ void DeleteFileWInSubdirectory(const std::wstring& dir) {
 
     // Attempt to delete
     if (DeleteFileW(file.c_str())) {
+        WaitForFileGone(file);
         HANDLE hFind = FindFirstFileW(file.c_str(), nullptr);
         if (hFind == INVALID_HANDLE_VALUE) {
             LogSuccess(L"DeleteFileW", L"Successfully deleted file located in subdirectory");
@@ -1102,7 +1626,6 @@ void DeleteFileWInSubdirectory(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\RemoveDirectoryWBasic";
 
     // Setup
@@ -1110,6 +1633,7 @@ void RemoveDirectoryWBasic(const std::wstring& dir) {
 
     // Remove
     if (RemoveDirectoryW(path.c_str())) {
+        WaitForFileGone(path);
         WIN32_FIND_DATAW data;
         HANDLE hFind = FindFirstFileW(path.c_str(), &data);
         if (hFind == INVALID_HANDLE_VALUE) {
@@ -1124,7 +1648,6 @@ void RemoveDirectoryWBasic(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWNonEmpty(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\RemoveDirectoryWNonEmpty";
     std::wstring file = dir + L"\\RemoveDirectoryWNonEmpty\\file.txt";
 
@@ -1151,14 +1674,14 @@ void RemoveDirectoryWNonEmpty(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWRelativePath(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    std::wstring path = dir + L".\\RemoveDirectoryWRelativePath";
+    std::wstring path = dir + L"\\.\\RemoveDirectoryWRelativePath";
 
     // Setup
     CreateDirectoryW(path.c_str(), nullptr);
 
     // Remove
     if (RemoveDirectoryW(path.c_str())) {
+        WaitForFileGone(path);
         HANDLE hFind = FindFirstFileW(path.c_str(), nullptr);
         if (hFind == INVALID_HANDLE_VALUE) {
             LogSuccess(L"RemoveDirectoryW", L"Successfully removed directory via relative path");
@@ -1172,7 +1695,6 @@ void RemoveDirectoryWRelativePath(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWNotExist(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\RemoveDirectoryWNotExist";
 
     // Ensure clean state
@@ -1191,7 +1713,6 @@ void RemoveDirectoryWNotExist(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWWithTrailingSlash(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring base = dir + L"\\RemoveDirectoryWWithTrailingSlash";
     wchar_t pathWithSlash[MAX_PATH];
     swprintf_s(pathWithSlash, L"%s\\", base.c_str());
@@ -1201,6 +1722,7 @@ void RemoveDirectoryWWithTrailingSlash(const std::wstring& dir) {
 
     // Attempt removal
     if (RemoveDirectoryW(pathWithSlash)) {
+        WaitForFileGone(base);
         HANDLE hFind = FindFirstFileW(base.c_str(), nullptr);
         if (hFind == INVALID_HANDLE_VALUE) {
             LogSuccess(L"RemoveDirectoryW", L"Successfully removed directory with trailing slash");
@@ -1214,7 +1736,6 @@ void RemoveDirectoryWWithTrailingSlash(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWHasSubdirectory(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring parent = dir + L"\\RemoveDirectoryWHasSubdirectory";
     std::wstring child = dir + L"\\RemoveDirectoryWHasSubdirectory\\sub";
 
@@ -1243,7 +1764,6 @@ void RemoveDirectoryWHasSubdirectory(const std::wstring& dir) {
 }
 
 void RemoveDirectoryWSubdirectoryOfParent(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring parent = dir + L"\\RemoveDirectoryWSubdirectoryOfParent";
     std::wstring subdir = dir + L"\\RemoveDirectoryWSubdirectoryOfParent\\child";
 
@@ -1253,6 +1773,7 @@ void RemoveDirectoryWSubdirectoryOfParent(const std::wstring& dir) {
 
     // Attempt to remove child directory
     if (RemoveDirectoryW(subdir.c_str())) {
+        WaitForFileGone(subdir);
         HANDLE hFind = FindFirstFileW(subdir.c_str(), nullptr);
         if (hFind == INVALID_HANDLE_VALUE) {
             LogSuccess(L"RemoveDirectoryW", L"Successfully removed subdirectory of parent");
@@ -1269,7 +1790,6 @@ void RemoveDirectoryWSubdirectoryOfParent(const std::wstring& dir) {
 }
 
 void SetFileAttributesWReadOnly(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWReadOnly.txt";
 
     // Setup: create file and make it read-only
@@ -1306,7 +1826,6 @@ void SetFileAttributesWReadOnly(const std::wstring& dir) {
 }
 
 void SetFileAttributesWHidden(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWHidden.txt";
 
     // Setup: create file
@@ -1324,6 +1843,7 @@ void SetFileAttributesWHidden(const std::wstring& dir) {
     }
 
     // Confirm file is directly findable by full name
+    WaitForAttributes(path, FILE_ATTRIBUTE_HIDDEN);
     WIN32_FIND_DATAW data;
     HANDLE hFindDirect = FindFirstFileW(path.c_str(), &data);
     if (hFindDirect == INVALID_HANDLE_VALUE) {
@@ -1333,7 +1853,7 @@ void SetFileAttributesWHidden(const std::wstring& dir) {
 
         // Confirm file is NOT found in wildcard search like "*"
         bool foundInWildcard = false;
-        HANDLE hFindWildcard = FindFirstFileW(L"*", &data);
+        HANDLE hFindWildcard = FindFirstFileW((dir + L"\\*").c_str(), &data);
         while (hFindWildcard != INVALID_HANDLE_VALUE) {
             if (_wcsicmp(data.cFileName, path.c_str()) == 0) {
                 foundInWildcard = true;
@@ -1357,7 +1877,6 @@ void SetFileAttributesWHidden(const std::wstring& dir) {
 }
 
 void SetFileAttributesWSystem(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWSystem.txt";
 
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
@@ -1368,6 +1887,7 @@ void SetFileAttributesWSystem(const std::wstring& dir) {
     CloseHandle(h);
 
     if (SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_SYSTEM)) {
+        WaitForAttributes(path, FILE_ATTRIBUTE_SYSTEM);
         DWORD attrs = GetFileAttributesW(path.c_str());
         if (attrs != INVALID_FILE_ATTRIBUTES && (attrs & FILE_ATTRIBUTE_SYSTEM)) {
             LogSuccess(L"SetFileAttributesW", L"Successfully set FILE_ATTRIBUTE_SYSTEM");
@@ -1384,7 +1904,6 @@ void SetFileAttributesWSystem(const std::wstring& dir) {
 }
 
 void SetFileAttributesWInvalidFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWInvalidFile.txt";
 
     DeleteFileW(path.c_str()); // Ensure it does not exist
@@ -1404,7 +1923,6 @@ void SetFileAttributesWInvalidFile(const std::wstring& dir) {
 }
 
 void SetFileAttributesWClearAttributes(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWClearAttributes.txt";
 
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_READONLY, nullptr);
@@ -1417,6 +1935,7 @@ void SetFileAttributesWClearAttributes(const std::wstring& dir) {
     SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_READONLY); // Explicitly apply attributes
 
     if (SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL)) {
+        WaitUntil([&] { return GetFileAttributesW(path.c_str()) == FILE_ATTRIBUTE_NORMAL; });
         DWORD attrs = GetFileAttributesW(path.c_str());
         if (attrs == FILE_ATTRIBUTE_NORMAL) {
             LogSuccess(L"SetFileAttributesW", L"Successfully cleared attributes to FILE_ATTRIBUTE_NORMAL");
@@ -1431,7 +1950,6 @@ void SetFileAttributesWClearAttributes(const std::wstring& dir) {
 }
 
 void SetEndOfFileTruncate(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetEndOfFileTruncate.txt";
 
     // Setup: create file with data
@@ -1468,7 +1986,6 @@ void SetEndOfFileTruncate(const std::wstring& dir) {
 }
 
 void SetEndOfFileExtend(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetEndOfFileExtend.txt";
 
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE | GENERIC_READ, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
@@ -1504,7 +2021,6 @@ void SetEndOfFileExtend(const std::wstring& dir) {
 }
 
 void SetEndOfFileAtExactSize(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetEndOfFileAtExactSize.txt";
 
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE | GENERIC_READ, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
@@ -1540,7 +2056,6 @@ void SetEndOfFileAtExactSize(const std::wstring& dir) {
 }
 
 void SetEndOfFileInvalidHandle(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     HANDLE hInvalid = (HANDLE)-1; // Known invalid handle
 
     if (!SetEndOfFile(hInvalid)) {
@@ -1556,7 +2071,6 @@ void SetEndOfFileInvalidHandle(const std::wstring& dir) {
 }
 
 void SetEndOfFileOnReadOnlyHandle(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetEndOfFileOnReadOnlyHandle.txt";
 
     // Setup: create file
@@ -1588,7 +2102,6 @@ void SetEndOfFileOnReadOnlyHandle(const std::wstring& dir) {
 }
 
 void SetFileAttributesWReadonlyBlocksWrite(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWReadonly.txt";
     DeleteFileW(path.c_str());
 
@@ -1614,7 +2127,6 @@ void SetFileAttributesWReadonlyBlocksWrite(const std::wstring& dir) {
 }
 
 void SetFileAttributesWHiddenHidesFromWildcard(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWHidden.txt";
     DeleteFileW(path.c_str());
 
@@ -1627,8 +2139,9 @@ void SetFileAttributesWHiddenHidesFromWildcard(const std::wstring& dir) {
 
     SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_HIDDEN);
 
+    WaitForAttributes(path, FILE_ATTRIBUTE_HIDDEN);
     WIN32_FIND_DATAW data;
-    HANDLE hFind = FindFirstFileW(L"*", &data);
+    HANDLE hFind = FindFirstFileW((dir + L"\\*").c_str(), &data);
     bool found = false;
 
     while (hFind != INVALID_HANDLE_VALUE) {
@@ -1651,7 +2164,6 @@ void SetFileAttributesWHiddenHidesFromWildcard(const std::wstring& dir) {
 }
 
 void SetFileAttributesWNormalClearsOtherFlags(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWNormal.txt";
     DeleteFileW(path.c_str());
 
@@ -1664,6 +2176,7 @@ void SetFileAttributesWNormalClearsOtherFlags(const std::wstring& dir) {
 
     SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
 
+    WaitUntil([&] { return GetFileAttributesW(path.c_str()) == FILE_ATTRIBUTE_NORMAL; });
     DWORD attrs = GetFileAttributesW(path.c_str());
     if (attrs == FILE_ATTRIBUTE_NORMAL) {
         LogSuccess(L"SetFileAttributesW", L"Successfully cleared attributes to FILE_ATTRIBUTE_NORMAL");
@@ -1675,7 +2188,6 @@ void SetFileAttributesWNormalClearsOtherFlags(const std::wstring& dir) {
 }
 
 void SetFileAttributesWOnInvalidPathFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileAttributesWInvalidPath.txt";
     DeleteFileW(path.c_str());  // Ensure file doesn't exist
 
@@ -1690,7 +2202,6 @@ void SetFileAttributesWOnInvalidPathFails(const std::wstring& dir) {
 }
 
 void SetFileAttributesWDirectoryReadonly(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring ndir = dir + L"\\SetFileAttributesWDirectoryReadonly";
     std::wstring nestedFile = dir + L"\\SetFileAttributesWDirectoryReadonly\\file.txt";
 
@@ -1712,15 +2223,15 @@ void SetFileAttributesWDirectoryReadonly(const std::wstring& dir) {
 }
 
 void SetFileAttributesWDirectoryHidden(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring ndir = dir + L"\\SetFileAttributesWDirectoryHidden";
     RemoveDirectoryW(ndir.c_str());
     CreateDirectoryW(ndir.c_str(), nullptr);
 
     SetFileAttributesW(ndir.c_str(), FILE_ATTRIBUTE_HIDDEN);
 
+    WaitForAttributes(ndir, FILE_ATTRIBUTE_HIDDEN);
     WIN32_FIND_DATAW data;
-    HANDLE hFind = FindFirstFileW(L"*", &data);
+    HANDLE hFind = FindFirstFileW((dir + L"\\*").c_str(), &data);
     bool found = false;
 
     while (hFind != INVALID_HANDLE_VALUE) {
@@ -1743,13 +2254,13 @@ void SetFileAttributesWDirectoryHidden(const std::wstring& dir) {
 }
 
 void SetFileAttributesWDirectorySystem(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring ndir = dir + L"\\SetFileAttributesWDirectorySystem";
     RemoveDirectoryW(ndir.c_str());
     CreateDirectoryW(ndir.c_str(), nullptr);
 
     SetFileAttributesW(ndir.c_str(), FILE_ATTRIBUTE_SYSTEM);
 
+    WaitForAttributes(ndir, FILE_ATTRIBUTE_SYSTEM);
     DWORD attrs = GetFileAttributesW(ndir.c_str());
     if (attrs != INVALID_FILE_ATTRIBUTES && (attrs & FILE_ATTRIBUTE_SYSTEM)) {
         LogSuccess(L"SetFileAttributesW", L"Successfully applied SYSTEM attribute to directory");
@@ -1762,7 +2273,6 @@ void SetFileAttributesWDirectorySystem(const std::wstring& dir) {
 }
 
 void SetFileAttributesWDirectoryNormalClearsOthers(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring ndir = dir + L"\\SetFileAttributesWDirectoryNormal";
     RemoveDirectoryW(ndir.c_str());
     CreateDirectoryW(ndir.c_str(), nullptr);
@@ -1773,6 +2283,10 @@ void SetFileAttributesWDirectoryNormalClearsOthers(const std::wstring& dir) {
     // Clear with NORMAL
     SetFileAttributesW(ndir.c_str(), FILE_ATTRIBUTE_NORMAL);
 
+    WaitUntil([&] {
+        DWORD attrs = GetFileAttributesW(ndir.c_str());
+        return attrs == FILE_ATTRIBUTE_DIRECTORY || attrs == FILE_ATTRIBUTE_NORMAL;
+    });
     DWORD attrs = GetFileAttributesW(ndir.c_str());
     if (attrs == FILE_ATTRIBUTE_DIRECTORY || attrs == FILE_ATTRIBUTE_NORMAL) {
         LogSuccess(L"SetFileAttributesW", L"Successfully cleared attributes using FILE_ATTRIBUTE_NORMAL");
@@ -1784,7 +2298,6 @@ void SetFileAttributesWDirectoryNormalClearsOthers(const std::wstring& dir) {
 }
 
 void SetFileAttributesWDirectoryInvalidPathFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring ndir = dir + L"\\SetFileAttributesWDirectoryInvalidPath";
     RemoveDirectoryW(ndir.c_str());  // Ensure it doesn't exist
 
@@ -1799,7 +2312,6 @@ void SetFileAttributesWDirectoryInvalidPathFails(const std::wstring& dir) {
 }
 
 void SetFileInformationByHandleChangeTimes(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileInformationByHandleChangeTimes.txt";
 
     HANDLE h = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES | FILE_READ_ATTRIBUTES, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
@@ -1852,12 +2364,12 @@ void SetFileInformationByHandleChangeTimes(const std::wstring& dir) {
 }
 
 void SetFileInformationByHandleRenameFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring original = dir + L"\\SetFileInformationByHandleRenameFile_original.txt";
     const wchar_t* renamed = L"SetFileInformationByHandleRenameFile_renamed.txt";
+    std::wstring renamedPath = dir + L"\\" + renamed;
 
     // Setup
-    DeleteFileW(L"SetFileInformationByHandleRenameFile_renamed.txt");
+    DeleteFileW(renamedPath.c_str());
     HANDLE h = CreateFileW(original.c_str(), GENERIC_WRITE | DELETE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h == INVALID_HANDLE_VALUE) {
         LogFailure(L"SetFileInformationByHandle", L"Failed to create original file for rename");
@@ -1883,8 +2395,9 @@ void SetFileInformationByHandleRenameFile(const std::wstring& dir) {
 
     CloseHandle(h);
 
+    WaitForFileVisible(renamedPath);
     WIN32_FIND_DATAW data;
-    HANDLE hFind = FindFirstFileW(renamed, &data);
+    HANDLE hFind = FindFirstFileW(renamedPath.c_str(), &data);
     if (hFind != INVALID_HANDLE_VALUE) {
         FindClose(hFind);
         LogSuccess(L"SetFileInformationByHandle", L"Successfully renamed file using FILE_RENAME_INFO");
@@ -1893,16 +2406,16 @@ void SetFileInformationByHandleRenameFile(const std::wstring& dir) {
     }
 
     // Cleanup
-    DeleteFileW(renamed);
+    DeleteFileW(renamedPath.c_str());
 }
 
 void SetFileInformationByHandleRenameOverwrite(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring source = dir + L"\\SetFileInformationByHandleRenameOverwrite_src.txt";
     const wchar_t* dest = L"SetFileInformationByHandleRenameOverwrite_dst.txt";
+    std::wstring destPath = dir + L"\\" + dest;
 
     // Setup destination file to be overwritten
-    HANDLE hDst = CreateFileW(dest, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    HANDLE hDst = CreateFileW(destPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (hDst != INVALID_HANDLE_VALUE) {
         WriteFile(hDst, "existing", 8, nullptr, nullptr);
         CloseHandle(hDst);
@@ -1912,7 +2425,7 @@ void SetFileInformationByHandleRenameOverwrite(const std::wstring& dir) {
     HANDLE h = CreateFileW(source.c_str(), DELETE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h == INVALID_HANDLE_VALUE) {
         LogFailure(L"SetFileInformationByHandle", L"Failed to create source file for overwrite test");
-        DeleteFileW(dest);
+        DeleteFileW(destPath.c_str());
         return;
     }
 
@@ -1928,14 +2441,15 @@ void SetFileInformationByHandleRenameOverwrite(const std::wstring& dir) {
         LogFailure(L"SetFileInformationByHandle", L"Rename with overwrite failed. Error: " + std::to_wstring(err));
         CloseHandle(h);
         DeleteFileW(source.c_str());
-        DeleteFileW(dest);
+        DeleteFileW(destPath.c_str());
         return;
     }
 
     CloseHandle(h);
 
+    WaitForFileVisible(destPath);
     WIN32_FIND_DATAW findData;
-    HANDLE hFind = FindFirstFileW(dest, &findData);
+    HANDLE hFind = FindFirstFileW(destPath.c_str(), &findData);
     if (hFind != INVALID_HANDLE_VALUE) {
         FindClose(hFind);
         LogSuccess(L"SetFileInformationByHandle", L"Successfully renamed file and replaced existing target");
@@ -1944,13 +2458,12 @@ void SetFileInformationByHandleRenameOverwrite(const std::wstring& dir) {
     }
 
     // Cleanup
-    DeleteFileW(dest);
+    DeleteFileW(destPath.c_str());
 }
 
 void SetFileInformationByHandleRenameWithRoot(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring baseDir = dir + L"\\SetFileInformationByHandleRenameWithRoot_dir";
-    std::wstring fileName = dir + L"\\source.txt";
+    const wchar_t* fileName = L"source.txt";
     const wchar_t* newName = L"renamed.txt";
 
     CreateDirectoryW(baseDir.c_str(), nullptr);
@@ -1965,7 +2478,7 @@ void SetFileInformationByHandleRenameWithRoot(const std::wstring& dir) {
 
     // Create file inside directory
     wchar_t fullPath[MAX_PATH];
-    swprintf_s(fullPath, L"%s\\%s", baseDir.c_str(), fileName.c_str());
+    swprintf_s(fullPath, L"%s\\%s", baseDir.c_str(), fileName);
     HANDLE hFile = CreateFileW(fullPath, DELETE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (hFile == INVALID_HANDLE_VALUE) {
         LogFailure(L"SetFileInformationByHandle", L"Failed to create file in root directory");
@@ -1994,6 +2507,7 @@ void SetFileInformationByHandleRenameWithRoot(const std::wstring& dir) {
 
     wchar_t renamedPath[MAX_PATH];
     swprintf_s(renamedPath, L"%s\\%ls", baseDir.c_str(), newName);
+    WaitForFileVisible(renamedPath);
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(renamedPath, &findData);
     if (hFind != INVALID_HANDLE_VALUE) {
@@ -2009,7 +2523,6 @@ void SetFileInformationByHandleRenameWithRoot(const std::wstring& dir) {
 }
 
 void SetFileInformationByHandleDeleteFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileInformationByHandleDeleteFile.txt";
 
     // Setup
@@ -2033,6 +2546,7 @@ void SetFileInformationByHandleDeleteFile(const std::wstring& dir) {
     // Close handle — this is when deletion is committed
     CloseHandle(h);
 
+    WaitForFileGone(path);
     HANDLE hFind = FindFirstFileW(path.c_str(), nullptr);
     if (hFind == INVALID_HANDLE_VALUE) {
         LogSuccess(L"SetFileInformationByHandle", L"File successfully deleted using FILE_DISPOSITION_INFO");
@@ -2044,7 +2558,6 @@ void SetFileInformationByHandleDeleteFile(const std::wstring& dir) {
 }
 
 void SetFileInformationByHandleTruncateFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileInformationByHandleTruncateFile.txt";
 
     // Setup: create file and write content
@@ -2080,7 +2593,6 @@ void SetFileInformationByHandleTruncateFile(const std::wstring& dir) {
 }
 
 void SetFileInformationByHandleDeleteReadOnlyFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFileInformationByHandleDeleteReadOnlyFile.txt";
 
     // Create file with READONLY attribute
@@ -2111,6 +2623,7 @@ void SetFileInformationByHandleDeleteReadOnlyFile(const std::wstring& dir) {
 
     CloseHandle(h);
 
+    WaitForFileGone(path);
     HANDLE hFind = FindFirstFileW(path.c_str(), nullptr);
     if (hFind == INVALID_HANDLE_VALUE) {
         LogSuccess(L"SetFileInformationByHandle", L"Successfully deleted previously read-only file using FILE_DISPOSITION_INFO");
@@ -2122,7 +2635,6 @@ void SetFileInformationByHandleDeleteReadOnlyFile(const std::wstring& dir) {
 }
 
 void WriteFileBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\WriteFileBasic.txt";
     DeleteFileW(path.c_str());
 
@@ -2158,7 +2670,6 @@ void WriteFileBasic(const std::wstring& dir) {
 }
 
 void WriteFileAppendMode(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\WriteFileAppendMode.txt";
     DeleteFileW(path.c_str());
 
@@ -2196,7 +2707,6 @@ void WriteFileAppendMode(const std::wstring& dir) {
 }
 
 void WriteFileWithOffset(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\WriteFileWithOffset.txt";
     DeleteFileW(path.c_str());
 
@@ -2226,7 +2736,6 @@ void WriteFileWithOffset(const std::wstring& dir) {
 }
 
 void WriteFileToReadOnlyFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\WriteFileToReadOnlyFile.txt";
     DeleteFileW(path.c_str());
 
@@ -2252,7 +2761,6 @@ void WriteFileToReadOnlyFile(const std::wstring& dir) {
 }
 
 void WriteFileInvalidHandle(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     HANDLE h = (HANDLE)-1; // Invalid handle
     DWORD written;
     BOOL success = WriteFile(h, "fail", 4, &written, nullptr);
@@ -2266,7 +2774,6 @@ void WriteFileInvalidHandle(const std::wstring& dir) {
 }
 
 void WriteFileBeyondEOF(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFilePointerBeyondEOFThenWrite.txt";
     DeleteFileW(path.c_str());
 
@@ -2292,7 +2799,6 @@ void WriteFileBeyondEOF(const std::wstring& dir) {
 }
 
 void LockFileBasicExclusive(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\LockFileBasicExclusive.txt";
     DeleteFileW(path.c_str());
 
@@ -2342,7 +2848,6 @@ void LockFileBasicExclusive(const std::wstring& dir) {
 }
 
 void LockFileNonOverlappingSuccess(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\LockFileNonOverlappingSuccess.txt";
     DeleteFileW(path.c_str());
 
@@ -2379,7 +2884,6 @@ void LockFileNonOverlappingSuccess(const std::wstring& dir) {
 }
 
 void LockFileUnlockRegion(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\LockFileUnlockRegion.txt";
     DeleteFileW(path.c_str());
 
@@ -2408,7 +2912,6 @@ void LockFileUnlockRegion(const std::wstring& dir) {
 }
 
 void LockFileAlreadyLockedFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\LockFileAlreadyLockedFails.txt";
     DeleteFileW(path.c_str());
 
@@ -2437,7 +2940,6 @@ void LockFileAlreadyLockedFails(const std::wstring& dir) {
 }
 
 void LockFileInvalidHandle(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     HANDLE h = (HANDLE)-1;
     BOOL result = LockFile(h, 0, 0, 5, 0);
     DWORD err = GetLastError();
@@ -2450,7 +2952,6 @@ void LockFileInvalidHandle(const std::wstring& dir) {
 }
 
 void UnlockFileBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\UnlockFileBasic.txt";
     DeleteFileW(path.c_str());
 
@@ -2480,7 +2981,6 @@ void UnlockFileBasic(const std::wstring& dir) {
 }
 
 void UnlockFileWithoutLockFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\UnlockFileWithoutLockFails.txt";
     DeleteFileW(path.c_str());
 
@@ -2505,7 +3005,6 @@ void UnlockFileWithoutLockFails(const std::wstring& dir) {
 }
 
 void UnlockFileWrongRegionFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\UnlockFileWrongRegionFails.txt";
     DeleteFileW(path.c_str());
 
@@ -2534,7 +3033,6 @@ void UnlockFileWrongRegionFails(const std::wstring& dir) {
 }
 
 void UnlockFileWithInvalidHandle(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     HANDLE h = (HANDLE)-1;
     BOOL result = UnlockFile(h, 0, 0, 5, 0);
     DWORD err = GetLastError();
@@ -2547,7 +3045,6 @@ void UnlockFileWithInvalidHandle(const std::wstring& dir) {
 }
 
 void UnlockFilePartialUnlockThenAccess(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\UnlockFilePartialUnlockThenAccess.txt";
     DeleteFileW(path.c_str());
 
@@ -2587,7 +3084,6 @@ void UnlockFilePartialUnlockThenAccess(const std::wstring& dir) {
 }
 
 void ReadFileBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\ReadFileBasic.txt";
     DeleteFileW(path.c_str());
 
@@ -2614,7 +3110,6 @@ void ReadFileBasic(const std::wstring& dir) {
 }
 
 void ReadFilePartial(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\ReadFilePartial.txt";
     DeleteFileW(path.c_str());
 
@@ -2636,7 +3131,6 @@ void ReadFilePartial(const std::wstring& dir) {
 }
 
 void ReadFileAtEOFReturnsZero(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\ReadFileAtEOFReturnsZero.txt";
     DeleteFileW(path.c_str());
 
@@ -2658,7 +3152,6 @@ void ReadFileAtEOFReturnsZero(const std::wstring& dir) {
 }
 
 void ReadFileClosedHandleFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\ReadFileClosedHandleFails.txt";
     DeleteFileW(path.c_str());
 
@@ -2682,7 +3175,6 @@ void ReadFileClosedHandleFails(const std::wstring& dir) {
 }
 
 void ReadFileInvalidHandleFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     HANDLE h = (HANDLE)-1;
     char buffer[4];
     DWORD read = 0;
@@ -2698,7 +3190,6 @@ void ReadFileInvalidHandleFails(const std::wstring& dir) {
 }
 
 void ReadFileStart(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFilePointerToStart.txt";
     DeleteFileW(path.c_str());
 
@@ -2727,7 +3218,6 @@ void ReadFileStart(const std::wstring& dir) {
 }
 
 void ReadFileMiddle(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFilePointerToMiddle.txt";
     DeleteFileW(path.c_str());
 
@@ -2751,7 +3241,6 @@ void ReadFileMiddle(const std::wstring& dir) {
 }
 
 void ReadFileEnd(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\SetFilePointerToEnd.txt";
     DeleteFileW(path.c_str());
 
@@ -2775,15 +3264,16 @@ void ReadFileEnd(const std::wstring& dir) {
 }
 
 void FindFirstFileWExactMatch(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     const wchar_t* filename = L"FindFirstFileWExactMatch.txt";
-    DeleteFileW(filename);
+    std::wstring path = dir + L"\\" + filename;
+    DeleteFileW(path.c_str());
 
-    HANDLE h = CreateFileW(filename, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
 
+    WaitForFileVisible(path);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(filename, &data);
+    HANDLE find = FindFirstFileW(path.c_str(), &data);
 
     if (find != INVALID_HANDLE_VALUE && wcscmp(data.cFileName, filename) == 0) {
         LogSuccess(L"FindFirstFileW", L"Successfully found file by exact name");
@@ -2792,19 +3282,21 @@ void FindFirstFileWExactMatch(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Failed to find file by exact name");
     }
 
-    DeleteFileW(filename);
+    DeleteFileW(path.c_str());
 }
 
 void FindFirstFileWWildcardMatch(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     const wchar_t* filename = L"FindFirstFileWWildcardMatch.log";
-    DeleteFileW(filename);
+    std::wstring path = dir + L"\\" + filename;
+    std::wstring pattern = dir + L"\\FindFirstFileWWildcardMatch.*";
+    DeleteFileW(path.c_str());
 
-    HANDLE h = CreateFileW(filename, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
 
+    WaitForFileVisible(path);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(L"FindFirstFileWWildcardMatch.*", &data);
+    HANDLE find = FindFirstFileW(pattern.c_str(), &data);
     bool found = false;
 
     while (find != INVALID_HANDLE_VALUE) {
@@ -2823,19 +3315,21 @@ void FindFirstFileWWildcardMatch(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Wildcard search did not find expected file");
     }
 
-    DeleteFileW(filename);
+    DeleteFileW(path.c_str());
 }
 
 void FindFirstFileWExtensionMatch(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     const wchar_t* filename = L"FindFirstFileWExtensionMatch.txt";
-    DeleteFileW(filename);
+    std::wstring path = dir + L"\\" + filename;
+    std::wstring pattern = dir + L"\\*.txt";
+    DeleteFileW(path.c_str());
 
-    HANDLE h = CreateFileW(filename, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
 
+    WaitForFileVisible(path);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(L"*.txt", &data);
+    HANDLE find = FindFirstFileW(pattern.c_str(), &data);
     bool found = false;
 
     while (find != INVALID_HANDLE_VALUE) {
@@ -2854,15 +3348,14 @@ void FindFirstFileWExtensionMatch(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Failed to find file using *.txt pattern");
     }
 
-    DeleteFileW(filename);
+    DeleteFileW(path.c_str());
 }
 
 void FindFirstFileWNonexistentFails(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* pattern = L"FindFirstFileWDoesNotExist.*";
+    std::wstring pattern = dir + L"\\FindFirstFileWDoesNotExist.*";
 
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(pattern, &data);
+    HANDLE find = FindFirstFileW(pattern.c_str(), &data);
     DWORD err = GetLastError();
 
     if (find == INVALID_HANDLE_VALUE && err == ERROR_FILE_NOT_FOUND) {
@@ -2874,15 +3367,15 @@ void FindFirstFileWNonexistentFails(const std::wstring& dir) {
 }
 
 void FindFirstFileWHiddenFileVisibleByName(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* filename = L"FindFirstFileWHiddenFile.txt";
-    DeleteFileW(filename);
+    std::wstring path = dir + L"\\FindFirstFileWHiddenFile.txt";
+    DeleteFileW(path.c_str());
 
-    HANDLE h = CreateFileW(filename, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr);
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr);
     if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
 
+    WaitForFileVisible(path);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(filename, &data);
+    HANDLE find = FindFirstFileW(path.c_str(), &data);
 
     if (find != INVALID_HANDLE_VALUE && (data.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN)) {
         LogSuccess(L"FindFirstFileW", L"Successfully found hidden file by name");
@@ -2891,18 +3384,18 @@ void FindFirstFileWHiddenFileVisibleByName(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Failed to find hidden file by name");
     }
 
-    SetFileAttributesW(filename, FILE_ATTRIBUTE_NORMAL);
-    DeleteFileW(filename);
+    SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    DeleteFileW(path.c_str());
 }
 
 void FindFirstFileWDirectoryExactMatch(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* ndir = L"FindFirstFileWDirectoryExactMatch";
-    RemoveDirectoryW(ndir);
-    CreateDirectoryW(ndir, nullptr);
+    std::wstring ndir = dir + L"\\FindFirstFileWDirectoryExactMatch";
+    RemoveDirectoryW(ndir.c_str());
+    CreateDirectoryW(ndir.c_str(), nullptr);
 
+    WaitForFileVisible(ndir);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(ndir, &data);
+    HANDLE find = FindFirstFileW(ndir.c_str(), &data);
 
     if (find != INVALID_HANDLE_VALUE && (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
         LogSuccess(L"FindFirstFileW", L"Successfully matched directory by exact name");
@@ -2911,22 +3404,24 @@ void FindFirstFileWDirectoryExactMatch(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Failed to match directory by exact name");
     }
 
-    RemoveDirectoryW(ndir);
+    RemoveDirectoryW(ndir.c_str());
 }
 
 void FindFirstFileWDirectoryWildcard(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* ndir = L"FindFirstFileWDirectoryWildcard";
-    RemoveDirectoryW(ndir);
-    CreateDirectoryW(ndir, nullptr);
+    const wchar_t* name = L"FindFirstFileWDirectoryWildcard";
+    std::wstring ndir = dir + L"\\" + name;
+    std::wstring pattern = dir + L"\\FindFirstFileWDirectory*";
+    RemoveDirectoryW(ndir.c_str());
+    CreateDirectoryW(ndir.c_str(), nullptr);
 
+    WaitForFileVisible(ndir);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(L"FindFirstFileWDirectory*", &data);
+    HANDLE find = FindFirstFileW(pattern.c_str(), &data);
     bool found = false;
 
     while (find != INVALID_HANDLE_VALUE) {
         if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
-            wcscmp(data.cFileName, ndir) == 0) {
+            wcscmp(data.cFileName, name) == 0) {
             found = true;
             break;
         }
@@ -2941,18 +3436,18 @@ void FindFirstFileWDirectoryWildcard(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Wildcard search failed to find expected directory");
     }
 
-    RemoveDirectoryW(ndir);
+    RemoveDirectoryW(ndir.c_str());
 }
 
 void FindFirstFileWDirectoryHiddenAttribute(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* ndir = L"FindFirstFileWDirectoryHidden";
-    RemoveDirectoryW(ndir);
-    CreateDirectoryW(ndir, nullptr);
-    SetFileAttributesW(ndir, FILE_ATTRIBUTE_HIDDEN);
+    std::wstring ndir = dir + L"\\FindFirstFileWDirectoryHidden";
+    RemoveDirectoryW(ndir.c_str());
+    CreateDirectoryW(ndir.c_str(), nullptr);
+    SetFileAttributesW(ndir.c_str(), FILE_ATTRIBUTE_HIDDEN);
 
+    WaitForAttributes(ndir, FILE_ATTRIBUTE_HIDDEN);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(ndir, &data);
+    HANDLE find = FindFirstFileW(ndir.c_str(), &data);
 
     if (find != INVALID_HANDLE_VALUE && (data.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN) &&
         (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
@@ -2963,25 +3458,24 @@ void FindFirstFileWDirectoryHiddenAttribute(const std::wstring& dir) {
 
     if (find != INVALID_HANDLE_VALUE) FindClose(find);
 
-    SetFileAttributesW(ndir, FILE_ATTRIBUTE_NORMAL);
-    RemoveDirectoryW(ndir);
+    SetFileAttributesW(ndir.c_str(), FILE_ATTRIBUTE_NORMAL);
+    RemoveDirectoryW(ndir.c_str());
 }
 
 void FindFirstFileWDirectoryEnumerateSubdirs(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* parent = L"FindFirstFileWDirectoryEnumerateSubdirs";
-    const wchar_t* subdir = L"FindFirstFileWDirectoryEnumerateSubdirs\\sub";
+    std::wstring parent = dir + L"\\FindFirstFileWDirectoryEnumerateSubdirs";
+    std::wstring subdir = parent + L"\\sub";
 
-    RemoveDirectoryW(subdir);
-    RemoveDirectoryW(parent);
-    CreateDirectoryW(parent, nullptr);
-    CreateDirectoryW(subdir, nullptr);
+    RemoveDirectoryW(subdir.c_str());
+    RemoveDirectoryW(parent.c_str());
+    CreateDirectoryW(parent.c_str(), nullptr);
+    CreateDirectoryW(subdir.c_str(), nullptr);
 
-    wchar_t searchPattern[MAX_PATH];
-    swprintf_s(searchPattern, L"%s\\*", parent);
+    std::wstring searchPattern = parent + L"\\*";
 
+    WaitForFileVisible(subdir);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(searchPattern, &data);
+    HANDLE find = FindFirstFileW(searchPattern.c_str(), &data);
     bool foundSubdir = false;
 
     while (find != INVALID_HANDLE_VALUE) {
@@ -3001,21 +3495,20 @@ void FindFirstFileWDirectoryEnumerateSubdirs(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Failed to enumerate expected subdirectory");
     }
 
-    RemoveDirectoryW(subdir);
-    RemoveDirectoryW(parent);
+    RemoveDirectoryW(subdir.c_str());
+    RemoveDirectoryW(parent.c_str());
 }
 
 void FindFirstFileWDirectoryDotDot(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* ndir = L"FindFirstFileWDirectoryDotDot";
-    RemoveDirectoryW(ndir);
-    CreateDirectoryW(ndir, nullptr);
+    std::wstring ndir = dir + L"\\FindFirstFileWDirectoryDotDot";
+    RemoveDirectoryW(ndir.c_str());
+    CreateDirectoryW(ndir.c_str(), nullptr);
 
-    wchar_t pattern[MAX_PATH];
-    swprintf_s(pattern, L"%s\\*", ndir);
+    std::wstring pattern = ndir + L"\\*";
 
+    WaitForFileVisible(ndir);
     WIN32_FIND_DATAW data;
-    HANDLE find = FindFirstFileW(pattern, &data);
+    HANDLE find = FindFirstFileW(pattern.c_str(), &data);
     bool foundDot = false, foundDotDot = false;
 
     while (find != INVALID_HANDLE_VALUE) {
@@ -3032,29 +3525,30 @@ void FindFirstFileWDirectoryDotDot(const std::wstring& dir) {
         LogFailure(L"FindFirstFileW", L"Failed to find . and .. entries in directory");
     }
 
-    RemoveDirectoryW(ndir);
+    RemoveDirectoryW(ndir.c_str());
 }
 
 void FindFirstFileWRecursiveFiles(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* baseDir = L"FindFirstFileWRecursiveFiles";
-    const wchar_t* subDir = L"FindFirstFileWRecursiveFiles\\nested";
-    const wchar_t* files[] = {
-        L"FindFirstFileWRecursiveFiles\\file1.txt",
-        L"FindFirstFileWRecursiveFiles\\nested\\file2.txt"
+    std::wstring baseDir = dir + L"\\FindFirstFileWRecursiveFiles";
+    std::wstring subDir = baseDir + L"\\nested";
+    std::wstring files[] = {
+        baseDir + L"\\file1.txt",
+        subDir + L"\\file2.txt"
     };
 
     // Setup: create directory and files
-    RemoveDirectoryW(subDir);
-    RemoveDirectoryW(baseDir);
-    CreateDirectoryW(baseDir, nullptr);
-    CreateDirectoryW(subDir, nullptr);
+    RemoveDirectoryW(subDir.c_str());
+    RemoveDirectoryW(baseDir.c_str());
+    CreateDirectoryW(baseDir.c_str(), nullptr);
+    CreateDirectoryW(subDir.c_str(), nullptr);
 
     for (int i = 0; i < 2; ++i) {
-        HANDLE h = CreateFileW(files[i], GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        HANDLE h = CreateFileW(files[i].c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
         if (h != INVALID_HANDLE_VALUE) CloseHandle(h);
     }
 
+    WaitForFileVisible(files[1]);
+
     // Recursive traversal to find all .txt files
     std::vector<std::wstring> found;
     std::function<void(const std::wstring&)> recurse = [&](const std::wstring& dir) {
@@ -3086,30 +3580,31 @@ void FindFirstFileWRecursiveFiles(const std::wstring& dir) {
     }
 
     // Cleanup
-    for (const auto& f : files) DeleteFileW(f);
-    RemoveDirectoryW(subDir);
-    RemoveDirectoryW(baseDir);
+    for (const auto& f : files) DeleteFileW(f.c_str());
+    RemoveDirectoryW(subDir.c_str());
+    RemoveDirectoryW(baseDir.c_str());
 }
 
 void FindFirstFileWRecursiveDirectories(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    const wchar_t* baseDir = L"FindFirstFileWRecursiveDirectories";
-    const wchar_t* subDirs[] = {
-        L"FindFirstFileWRecursiveDirectories\\a",
-        L"FindFirstFileWRecursiveDirectories\\a\\b",
-        L"FindFirstFileWRecursiveDirectories\\a\\b\\c"
+    std::wstring baseDir = dir + L"\\FindFirstFileWRecursiveDirectories";
+    std::wstring subDirs[] = {
+        baseDir + L"\\a",
+        baseDir + L"\\a\\b",
+        baseDir + L"\\a\\b\\c"
     };
 
     // Setup
     for (int i = 2; i >= 0; --i) {
-        RemoveDirectoryW(subDirs[i]);
+        RemoveDirectoryW(subDirs[i].c_str());
     }
-    RemoveDirectoryW(baseDir);
-    CreateDirectoryW(baseDir, nullptr);
+    RemoveDirectoryW(baseDir.c_str());
+    CreateDirectoryW(baseDir.c_str(), nullptr);
     for (int i = 0; i < 3; ++i) {
-        CreateDirectoryW(subDirs[i], nullptr);
+        CreateDirectoryW(subDirs[i].c_str(), nullptr);
     }
 
+    WaitForFileVisible(subDirs[2]);
+
     // Recursive directory discovery
     std::vector<std::wstring> found;
     std::function<void(const std::wstring&)> recurse = [&](const std::wstring& dir) {
@@ -3140,12 +3635,11 @@ void FindFirstFileWRecursiveDirectories(const std::wstring& dir) {
     }
 
     // Cleanup (deepest to shallowest)
-    for (int i = 2; i >= 0; --i) RemoveDirectoryW(subDirs[i]);
-    RemoveDirectoryW(baseDir);
+    for (int i = 2; i >= 0; --i) RemoveDirectoryW(subDirs[i].c_str());
+    RemoveDirectoryW(baseDir.c_str());
 }
 
 void GetCompressedFileSizeWCompressedFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\GetCompressedFileSizeWCompressed.txt";
     DeleteFileW(path.c_str());
 
@@ -3211,7 +3705,6 @@ void GetCompressedFileSizeWCompressedFile(const std::wstring& dir) {
 }
 
 void GetCompressedFileSizeWSparseFile(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
     std::wstring path = dir + L"\\GetCompressedFileSizeWSparse.txt";
     DeleteFileW(path.c_str());
 
@@ -3269,61 +3762,54 @@ void GetCompressedFileSizeWSparseFile(const std::wstring& dir) {
 }
 
 void GetDiskFreeSpaceWBasic(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    std::wstring path = dir + L"\\GetDiskFreeSpaceABasic.tmp";
+    std::wstring path = dir + L"\\GetDiskFreeSpaceWBasic.tmp";
     DeleteFileW(path.c_str());
 
-    DWORD spc = 0, bps = 0, freeBefore = 0, total = 0;
-    BOOL ok = GetDiskFreeSpaceA("C:\\", &spc, &bps, &freeBefore, &total);
-
-    if (!ok || spc == 0 || bps == 0) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Initial call failed or invalid values");
+    VolumeSpace before;
+    if (!QueryVolumeSpace(dir, before) || before.clusterSize == 0 || before.totalBytes == 0) {
+        LogFailure(L"GetDiskFreeSpaceExW", L"Initial call failed or invalid values");
         return;
     }
 
-    // Write a file large enough to span multiple clusters (e.g., 1MB)
+    // Write a file large enough to span multiple clusters
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h == INVALID_HANDLE_VALUE) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Failed to create test file");
+        LogFailure(L"GetDiskFreeSpaceExW", L"Failed to create test file");
         return;
     }
 
-    std::vector<char> buffer(spc * bps * 10, 'X');  // 10 clusters
+    std::vector<char> buffer((size_t)before.clusterSize * 10, 'X');  // 10 clusters
     DWORD written;
     WriteFile(h, buffer.data(), (DWORD)buffer.size(), &written, nullptr);
+    FlushFileBuffers(h);
     CloseHandle(h);
 
     // Query again
-    DWORD freeAfter = 0;
-    ok = GetDiskFreeSpaceA("C:\\", &spc, &bps, &freeAfter, &total);
-
-    if (!ok || freeAfter == 0) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Second query failed or invalid values");
+    VolumeSpace after;
+    if (!QueryVolumeSpace(dir, after) || after.freeBytes == 0) {
+        LogFailure(L"GetDiskFreeSpaceExW", L"Second query failed or invalid values");
         DeleteFileW(path.c_str());
         return;
     }
 
     // Compare before vs after
-    if (freeAfter < freeBefore) {
-        LogSuccess(L"GetDiskFreeSpaceA", L"Free clusters decreased after file write as expected");
+    if (after.freeBytes < before.freeBytes) {
+        LogSuccess(L"GetDiskFreeSpaceExW", L"Free space on " + before.root + L" decreased after file write as expected");
     } else {
-        LogFailure(L"GetDiskFreeSpaceA", L"Free space did not decrease after writing file");
+        LogFailure(L"GetDiskFreeSpaceExW", L"Free space on " + before.root + L" did not decrease after writing file");
     }
 
     DeleteFileW(path.c_str());
 }
 
 void GetDiskFreeSpaceWFileDeletionRestoresSpace(const std::wstring& dir) {
-	Sleep(SLEEP_MSEC);
-    std::wstring path = dir + L"\\GetDiskFreeSpaceAFileDeletion.tmp";
+    std::wstring path = dir + L"\\GetDiskFreeSpaceWFileDeletion.tmp";
     DeleteFileW(path.c_str());
 
-    DWORD spc = 0, bps = 0, freeBefore = 0, total = 0;
-    BOOL ok = GetDiskFreeSpaceA("C:\\", &spc, &bps, &freeBefore, &total);
-
-    if (!ok || spc == 0 || bps == 0) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Initial query failed or invalid values");
+    VolumeSpace before;
+    if (!QueryVolumeSpace(dir, before) || before.clusterSize == 0 || before.totalBytes == 0) {
+        LogFailure(L"GetDiskFreeSpaceExW", L"Initial query failed or invalid values");
         return;
     }
 
@@ -3331,20 +3817,20 @@ void GetDiskFreeSpaceWFileDeletionRestoresSpace(const std::wstring& dir) {
     HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h == INVALID_HANDLE_VALUE) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Failed to create test file");
+        LogFailure(L"GetDiskFreeSpaceExW", L"Failed to create test file");
         return;
     }
 
-    std::vector<char> buffer(spc * bps * 10, 'X');  // 10 clusters
+    std::vector<char> buffer((size_t)before.clusterSize * 10, 'X');  // 10 clusters
     DWORD written;
     WriteFile(h, buffer.data(), (DWORD)buffer.size(), &written, nullptr);
+    FlushFileBuffers(h);
     CloseHandle(h);
 
     // Query after file write
-    DWORD freeAfterWrite = 0;
-    ok = GetDiskFreeSpaceA("C:\\", &spc, &bps, &freeAfterWrite, &total);
-    if (!ok || freeAfterWrite == 0) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Query after write failed");
+    VolumeSpace afterWrite;
+    if (!QueryVolumeSpace(dir, afterWrite) || afterWrite.freeBytes == 0) {
+        LogFailure(L"GetDiskFreeSpaceExW", L"Query after write failed");
         DeleteFileW(path.c_str());
         return;
     }
@@ -3353,163 +3839,3992 @@ void GetDiskFreeSpaceWFileDeletionRestoresSpace(const std::wstring& dir) {
     DeleteFileW(path.c_str());
 
     // Query again after deletion
-    DWORD freeAfterDelete = 0;
-    ok = GetDiskFreeSpaceA("C:\\", &spc, &bps, &freeAfterDelete, &total);
-    if (!ok || freeAfterDelete == 0) {
-        LogFailure(L"GetDiskFreeSpaceA", L"Query after deletion failed");
+    VolumeSpace afterDelete;
+    if (!QueryVolumeSpace(dir, afterDelete) || afterDelete.freeBytes == 0) {
+        LogFailure(L"GetDiskFreeSpaceExW", L"Query after deletion failed");
         return;
     }
 
     // Compare
-    if (freeAfterDelete > freeAfterWrite) {
-        LogSuccess(L"GetDiskFreeSpaceA", L"Free clusters increased after deleting file");
+    if (afterDelete.freeBytes > afterWrite.freeBytes) {
+        LogSuccess(L"GetDiskFreeSpaceExW", L"Free space on " + before.root + L" increased after deleting file");
     } else {
-        LogFailure(L"GetDiskFreeSpaceA", L"Expected free space to increase after deletion, but it did not");
+        LogFailure(L"GetDiskFreeSpaceExW", L"Expected free space on " + before.root +
+                                           L" to increase after deletion, but it did not");
     }
 }
 
-int wmain(int argc, wchar_t* argv[]) {
-    if (argc != 2) {
-        std::wcerr << L"Usage: tester.exe <target_root_path>\n";
-        return 1;
+// Benchmarks
+
+// Parameters passed to a benchmark as `--name value` pairs after `bench <name>`.
+typedef std::map<std::wstring, std::wstring> BenchmarkOptions;
+
+// Parses a byte count with an optional binary suffix: 4K, 8M, 16G.
+ULONGLONG ParseSize(const std::wstring& text) {
+    wchar_t* end = nullptr;
+    ULONGLONG value = wcstoull(text.c_str(), &end, 10);
+    switch (*end) {
+    case L'K': case L'k': return value << 10;
+    case L'M': case L'm': return value << 20;
+    case L'G': case L'g': return value << 30;
+    default: return value;
     }
+}
 
-    std::wstring dir = argv[1];
-    CreateDirectoryW(dir.c_str(), nullptr); // Ensure test root exists
+// Checks that `text` is a whole count (digits only) or, when `suffix` is set,
+// a size with an optional K, M or G suffix that does not overflow.
+bool IsValidBenchmarkNumber(const std::wstring& text, bool suffix) {
+    size_t digits = 0;
+    ULONGLONG value = 0;
+    while (digits < text.size() && text[digits] >= L'0' && text[digits] <= L'9') {
+        if (value > (~0ULL - 9) / 10)
+            return false;
+        value = value * 10 + (text[digits++] - L'0');
+    }
+    if (digits == 0)
+        return false;
+    if (digits == text.size())
+        return true;
+    if (!suffix || digits + 1 != text.size())
+        return false;
+    wchar_t unit = text[digits];
+    int shift = unit == L'K' || unit == L'k' ? 10
+              : unit == L'M' || unit == L'm' ? 20
+              : unit == L'G' || unit == L'g' ? 30
+                                             : 0;
+    return shift != 0 && value <= (~0ULL >> shift);
+}
 
-    // --- FILE CREATION ---
-    CreateFileWCreateAlways(dir);
-    CreateFileWCreateNew(dir);
-    CreateFileWTruncateExisting(dir);
-    CreateFileWOpenExisting(dir);
-    CreateFileWOpenAlways(dir);
-    CreateFileWReadWriteAccess(dir);
+// Checks a value against the kind declared for its option: N, SIZE or a
+// comma-separated LIST of sizes.
+bool IsValidBenchmarkValue(const std::wstring& kind, const std::wstring& text) {
+    if (kind == L"N")
+        return IsValidBenchmarkNumber(text, false);
+    if (kind == L"SIZE")
+        return IsValidBenchmarkNumber(text, true);
+    size_t begin = 0;
+    for (;;) {
+        size_t comma = text.find(L',', begin);
+        if (!IsValidBenchmarkNumber(text.substr(begin, comma == std::wstring::npos ? comma : comma - begin), true))
+            return false;
+        if (comma == std::wstring::npos)
+            return true;
+        begin = comma + 1;
+    }
+}
 
-    // --- SYMBOLIC LINKS ---
-    CreateSymbolicLinkWFileLink(dir);
-    CreateSymbolicLinkWDirectoryLink(dir);
+// Option names and kinds declared in a BenchmarkCase options string, which
+// lists them as "--name N|SIZE|LIST (default)".
+std::map<std::wstring, std::wstring> GetDeclaredBenchmarkOptions(const wchar_t* declaration) {
+    std::map<std::wstring, std::wstring> declared;
+    std::wstring text = declaration;
+    for (size_t at = text.find(L"--"); at != std::wstring::npos; at = text.find(L"--", at + 2)) {
+        size_t nameEnd = text.find(L' ', at);
+        if (nameEnd == std::wstring::npos)
+            break;
+        size_t kindEnd = text.find_first_of(L" \n", nameEnd + 1);
+        declared[text.substr(at + 2, nameEnd - at - 2)] = text.substr(nameEnd + 1, kindEnd - nameEnd - 1);
+    }
+    return declared;
+}
 
-    // --- HARD LINKS ---
-    CreateHardLinkWBasic(dir);
-    CreateHardLinkWTargetMissing(dir);
-    CreateHardLinkWAlreadyExists(dir);
-    CreateHardLinkWModifyLinkReflectsInOriginal(dir);
+ULONGLONG GetBenchmarkCount(const BenchmarkOptions& options, const wchar_t* name, ULONGLONG defaultValue) {
+    auto it = options.find(name);
+    return it == options.end() ? defaultValue : wcstoull(it->second.c_str(), nullptr, 10);
+}
 
-    // --- DIRECTORY CREATION ---
-    CreateDirectoryWBasic(dir);
-    CreateDirectoryWAlreadyExists(dir);
-    CreateDirectoryWWithSubdirectories(dir);
-    CreateDirectoryWInvalidPath(dir);
-    CreateDirectoryWRelativePath(dir);
+ULONGLONG GetBenchmarkSize(const BenchmarkOptions& options, const wchar_t* name, ULONGLONG defaultValue) {
+    auto it = options.find(name);
+    return it == options.end() ? defaultValue : ParseSize(it->second);
+}
 
-    // --- FILE COPY ---
-    CopyFileWBasicCopy(dir);
-    CopyFileWFailIfExists(dir);
-    CopyFileWOverwriteAllowed(dir);
-    CopyFileWSourceMissing(dir);
-    CopyFileWSubdirToParent(dir);
-    CopyFileWParentToSubdir(dir);
-    CopyFileWFromSymbolicLink(dir);
+// Parses a comma-separated size list such as 4K,64K,1M.
+std::vector<ULONGLONG> GetBenchmarkSizeList(const BenchmarkOptions& options, const wchar_t* name,
+                                            const std::vector<ULONGLONG>& defaultValue) {
+    auto it = options.find(name);
+    if (it == options.end())
+        return defaultValue;
+    std::vector<ULONGLONG> values;
+    size_t begin = 0;
+    while (begin <= it->second.size()) {
+        size_t comma = it->second.find(L',', begin);
+        if (comma == std::wstring::npos)
+            comma = it->second.size();
+        if (comma > begin)
+            values.push_back(ParseSize(it->second.substr(begin, comma - begin)));
+        begin = comma + 1;
+    }
+    return values;
+}
 
-    // --- FILE MOVE ---
-    MoveFileWRenameSameDirectory(dir);
-    MoveFileWIntoSubdirectory(dir);
-    MoveFileWDestinationExists(dir);
-    MoveFileWSymbolicLinkItself(dir);
-    MoveFileWFromSubdirectoryToParent(dir);
-    MoveFileWDirectoryMoveBasic(dir);
-    MoveFileWDirectoryRenameInPlace(dir);
-    MoveFileWDirectoryIntoSubdirectory(dir);
-    MoveFileWDirectoryOverwriteExisting(dir);
+std::wstring FormatSize(ULONGLONG bytes) {
+    if (bytes >= (1ULL << 30) && bytes % (1ULL << 30) == 0) return std::to_wstring(bytes >> 30) + L"G";
+    if (bytes >= (1ULL << 20) && bytes % (1ULL << 20) == 0) return std::to_wstring(bytes >> 20) + L"M";
+    if (bytes >= (1ULL << 10) && bytes % (1ULL << 10) == 0) return std::to_wstring(bytes >> 10) + L"K";
+    return std::to_wstring(bytes);
+}
 
-    // --- FILE DELETE ---
-    DeleteFileWBasic(dir);
-    DeleteFileWNotExists(dir);
-    DeleteFileWReadOnlyFile(dir);
-    DeleteFileWOnDirectory(dir);
-    DeleteFileWRelativePath(dir);
-    DeleteFileWInSubdirectory(dir);
+// User plus kernel time of the whole process, so I/O completed on other
+// threads is charged as well.
+double ProcessCpuSeconds() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    ULONGLONG k = ((ULONGLONG)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    ULONGLONG u = ((ULONGLONG)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (double)(k + u) / 1e7;
+}
 
-    // --- DIRECTORY DELETE ---
-    RemoveDirectoryWBasic(dir);
-    RemoveDirectoryWNonEmpty(dir);
-    RemoveDirectoryWRelativePath(dir);
-    RemoveDirectoryWNotExist(dir);
-    RemoveDirectoryWWithTrailingSlash(dir);
-    RemoveDirectoryWHasSubdirectory(dir);
-    RemoveDirectoryWSubdirectoryOfParent(dir);
+// Prints one throughput line: volume, wall time, MB/s (10^6 bytes) and CPU
+// nanoseconds spent per byte moved.
+void PrintThroughput(const std::wstring& label, ULONGLONG bytes, double seconds, double cpuSeconds) {
+    wchar_t buffer[160];
+    swprintf_s(buffer, L"%llu MiB in %.2f s, %.1f MB/s, cpu %.3f ns/B", bytes >> 20, seconds,
+               seconds > 0.0 ? (double)bytes / 1e6 / seconds : 0.0,
+               bytes > 0 ? cpuSeconds * 1e9 / (double)bytes : 0.0);
+    std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+}
 
-    // --- FILE ATTRIBUTES ---
-    SetFileAttributesWReadOnly(dir);
-    SetFileAttributesWHidden(dir);
-    SetFileAttributesWSystem(dir);
-    SetFileAttributesWInvalidFile(dir);
-    SetFileAttributesWClearAttributes(dir);
-    SetFileAttributesWReadonlyBlocksWrite(dir);
-    SetFileAttributesWHiddenHidesFromWildcard(dir);
-    SetFileAttributesWNormalClearsOtherFlags(dir);
-    SetFileAttributesWOnInvalidPathFails(dir);
-    SetFileAttributesWDirectoryReadonly(dir);
-    SetFileAttributesWDirectoryHidden(dir);
-    SetFileAttributesWDirectorySystem(dir);
-    SetFileAttributesWDirectoryNormalClearsOthers(dir);
-    SetFileAttributesWDirectoryInvalidPathFails(dir);
+struct LatencyHistogram {
+    std::vector<ULONGLONG> counts = std::vector<ULONGLONG>(LATENCY_SUB_BUCKETS / 2 * 58, 0);
+    ULONGLONG total = 0;
+    ULONGLONG maximum = 0;
+};
+
+size_t LatencyBucketIndex(ULONGLONG nanoseconds) {
+    const ULONGLONG half = LATENCY_SUB_BUCKETS / 2;
+    if (nanoseconds < LATENCY_SUB_BUCKETS)
+        return (size_t)nanoseconds;
+    unsigned shift = 0;
+    while ((nanoseconds >> shift) >= LATENCY_SUB_BUCKETS)
+        ++shift;
+    return (size_t)(LATENCY_SUB_BUCKETS + (shift - 1) * half + ((nanoseconds >> shift) - half));
+}
 
-    // --- SET END OF FILE ---
-    SetEndOfFileTruncate(dir);
-    SetEndOfFileExtend(dir);
-    SetEndOfFileAtExactSize(dir);
-    SetEndOfFileInvalidHandle(dir);
-    SetEndOfFileOnReadOnlyHandle(dir);
+// Largest value that LatencyBucketIndex maps to `index`.
+ULONGLONG LatencyBucketHighest(size_t index) {
+    const ULONGLONG half = LATENCY_SUB_BUCKETS / 2;
+    if (index < LATENCY_SUB_BUCKETS)
+        return index;
+    unsigned shift = (unsigned)((index - LATENCY_SUB_BUCKETS) / half) + 1;
+    ULONGLONG top = (index - LATENCY_SUB_BUCKETS) % half + half;
+    return ((top + 1) << shift) - 1;
+}
 
-    // --- FILE INFORMATION ---
-    SetFileInformationByHandleDeleteFile(dir);
-    SetFileInformationByHandleTruncateFile(dir);
-    SetFileInformationByHandleDeleteReadOnlyFile(dir);
-    SetFileInformationByHandleRenameFile(dir);
-    SetFileInformationByHandleRenameOverwrite(dir);
-    SetFileInformationByHandleRenameWithRoot(dir);
-    SetFileInformationByHandleChangeTimes(dir);
+void RecordLatency(LatencyHistogram& histogram, ULONGLONG nanoseconds) {
+    histogram.counts[LatencyBucketIndex(nanoseconds)]++;
+    histogram.total++;
+    histogram.maximum = std::max(histogram.maximum, nanoseconds);
+}
 
-    // --- GET COMPRESSED FILE SIZE ---
-    GetCompressedFileSizeWCompressedFile(dir);
-    GetCompressedFileSizeWSparseFile(dir);
+void MergeLatency(LatencyHistogram& into, const LatencyHistogram& from) {
+    for (size_t i = 0; i < into.counts.size(); ++i)
+        into.counts[i] += from.counts[i];
+    into.total += from.total;
+    into.maximum = std::max(into.maximum, from.maximum);
+}
 
-    // --- DISK FREE SPACE ---
-    GetDiskFreeSpaceWBasic(dir);
-    GetDiskFreeSpaceWFileDeletionRestoresSpace(dir);
+ULONGLONG LatencyPercentile(const LatencyHistogram& histogram, double percentile) {
+    ULONGLONG target = (ULONGLONG)(percentile / 100.0 * (double)histogram.total + 0.5);
+    target = std::max<ULONGLONG>(target, 1);
+    ULONGLONG seen = 0;
+    for (size_t i = 0; i < histogram.counts.size(); ++i) {
+        seen += histogram.counts[i];
+        if (seen >= target)
+            return std::min(LatencyBucketHighest(i), histogram.maximum);
+    }
+    return histogram.maximum;
+}
 
-    // --- WRITE FILE ---
-    WriteFileBasic(dir);
-    WriteFileWithOffset(dir);
-    WriteFileBeyondEOF(dir);
-    WriteFileAppendMode(dir);
-    WriteFileToReadOnlyFile(dir);
-    WriteFileInvalidHandle(dir);
+std::wstring FormatMicroseconds(ULONGLONG nanoseconds) {
+    wchar_t buffer[32];
+    swprintf_s(buffer, L"%.1f us", (double)nanoseconds / 1000.0);
+    return buffer;
+}
 
-    // --- READ FILE ---
-    ReadFileBasic(dir);
-    ReadFilePartial(dir);
-    ReadFileAtEOFReturnsZero(dir);
-    ReadFileClosedHandleFails(dir);
-    ReadFileInvalidHandleFails(dir);
-    ReadFileStart(dir);
-    ReadFileMiddle(dir);
-    ReadFileEnd(dir);
+void PrintLatency(const std::wstring& label, const LatencyHistogram& histogram) {
+    std::wcout << L"[BENCH] " << label << L": n=" << histogram.total
+               << L" p50=" << FormatMicroseconds(LatencyPercentile(histogram, 50.0))
+               << L" p90=" << FormatMicroseconds(LatencyPercentile(histogram, 90.0))
+               << L" p99=" << FormatMicroseconds(LatencyPercentile(histogram, 99.0))
+               << L" p99.9=" << FormatMicroseconds(LatencyPercentile(histogram, 99.9))
+               << L" max=" << FormatMicroseconds(histogram.maximum) << std::endl;
+}
 
-    // --- LOCK FILE ---
-    LockFileBasicExclusive(dir);
-    LockFileInvalidHandle(dir);
-    LockFileNonOverlappingSuccess(dir);
-    LockFileAlreadyLockedFails(dir);
-    LockFileUnlockRegion(dir);
+// Times open/close cycles for every creation disposition and the access masks
+// used by the CreateFileW tests. CREATE_NEW needs a fresh name per cycle and
+// TRUNCATE_EXISTING a non-empty file; that setup stays outside the timing.
+void BenchmarkCreateFileWOpenLatency(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG iterations = GetBenchmarkCount(options, L"iterations", 100000);
+
+    struct { DWORD value; const wchar_t* name; } dispositions[] = {
+        { CREATE_ALWAYS, L"CREATE_ALWAYS" },
+        { CREATE_NEW, L"CREATE_NEW" },
+        { OPEN_EXISTING, L"OPEN_EXISTING" },
+        { OPEN_ALWAYS, L"OPEN_ALWAYS" },
+        { TRUNCATE_EXISTING, L"TRUNCATE_EXISTING" },
+    };
+    struct { DWORD value; const wchar_t* name; } accessMasks[] = {
+        { GENERIC_READ, L"GENERIC_READ" },
+        { GENERIC_WRITE, L"GENERIC_WRITE" },
+        { GENERIC_READ | GENERIC_WRITE, L"GENERIC_READ|GENERIC_WRITE" },
+    };
 
-    // --- UNLOCK FILE ---
-    UnlockFileBasic(dir);
-    UnlockFileWithoutLockFails(dir);
-    UnlockFileWrongRegionFails(dir);
-    UnlockFileWithInvalidHandle(dir);
-    UnlockFilePartialUnlockThenAccess(dir);
+    std::wstring path = dir + L"\\OpenLatency.txt";
+    for (const auto& disposition : dispositions) {
+        for (const auto& access : accessMasks) {
+            // TRUNCATE_EXISTING is rejected without write access.
+            if (disposition.value == TRUNCATE_EXISTING && !(access.value & GENERIC_WRITE))
+                continue;
+
+            std::wstring label = std::wstring(L"DesiredAccess=") + access.name +
+                                 L" CreationDisposition=" + disposition.name;
+            LatencyHistogram openLatency, closeLatency;
+            if (disposition.value != CREATE_NEW)
+                WriteDummyContent(path);
+
+            for (ULONGLONG i = 0; i < iterations; ++i) {
+                std::wstring target = path;
+                if (disposition.value == CREATE_NEW)
+                    target = dir + L"\\OpenLatency" + std::to_wstring(i) + L".txt";
+                else if (disposition.value == TRUNCATE_EXISTING && i != 0)
+                    WriteDummyContent(path);
+
+                LONGLONG start = QueryCounter();
+                HANDLE h = CreateFileW(target.c_str(), access.value, 0, nullptr, disposition.value,
+                                       FILE_ATTRIBUTE_NORMAL, nullptr);
+                LONGLONG opened = QueryCounter();
+                if (h == INVALID_HANDLE_VALUE) {
+                    LogFailure(L"CreateFileW", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                    break;
+                }
+                CloseHandle(h);
+                LONGLONG closed = QueryCounter();
+
+                RecordLatency(openLatency, CounterToNanoseconds(opened - start));
+                RecordLatency(closeLatency, CounterToNanoseconds(closed - opened));
+                if (disposition.value == CREATE_NEW)
+                    DeleteFileW(target.c_str());
+            }
+
+            PrintLatency(L"CreateFileW " + label, openLatency);
+            PrintLatency(L"CloseHandle " + label, closeLatency);
+            DeleteFileW(path.c_str());
+        }
+    }
+}
+
+// Sector size FILE_FLAG_NO_BUFFERING transfers on the volume of `path` must be
+// a multiple of, falling back to 4K when the volume does not report one.
+DWORD GetUnbufferedAlignment(const std::wstring& path) {
+    VolumeSpace volume;
+    return QueryVolumeSpace(path, volume) && volume.sectorSize != 0 ? volume.sectorSize : 4096;
+}
+
+// Rewrites the first `size` bytes of an existing file with CreateFilledFile's
+// pattern through a FILE_FLAG_NO_BUFFERING handle. Non-cached writes flush
+// and purge the cached pages of the range, locally and in an SMB client, so
+// the next buffered read of the file is cold.
+bool RewriteUncached(const std::wstring& path, ULONGLONG size) {
+    const DWORD blockSize = 1 << 20;
+    BYTE* block = (BYTE*)VirtualAlloc(nullptr, blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (block == nullptr)
+        return false;
+    for (DWORD i = 0; i < blockSize; ++i)
+        block[i] = (BYTE)(i * 31 + 7);
+
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+    bool ok = h != INVALID_HANDLE_VALUE;
+    for (ULONGLONG done = 0; ok && done < size;) {
+        // The tail is rounded up to a 4K sector and trimmed again below.
+        DWORD chunk = (DWORD)std::min<ULONGLONG>(blockSize, (size - done + 4095) & ~4095ULL);
+        DWORD written = 0;
+        ok = WriteFile(h, block, chunk, &written, nullptr) && written == chunk;
+        done += written;
+    }
+    if (ok) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        ok = SetFilePointerEx(h, end, nullptr, FILE_BEGIN) && SetEndOfFile(h);
+    }
+    DWORD error = GetLastError();
+    if (h != INVALID_HANDLE_VALUE)
+        CloseHandle(h);
+    VirtualFree(block, 0, MEM_RELEASE);
+    SetLastError(error);
+    return ok;
+}
+
+// Streams one file out and back in per flag set and block size. The write
+// pass includes FlushFileBuffers so buffered results reflect data that reached
+// the target, and buffered rows rewrite the file uncached before reading so
+// the read pass measures the target rather than the local cache. Buffers come
+// from VirtualAlloc, which satisfies the sector alignment
+// FILE_FLAG_NO_BUFFERING needs.
+void BenchmarkSequentialThroughput(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG fileSize = GetBenchmarkSize(options, L"file-size", 2ULL << 30);
+    std::vector<ULONGLONG> blockSizes = GetBenchmarkSizeList(
+        options, L"block-sizes", { 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 8 << 20 });
+    if (std::find(blockSizes.begin(), blockSizes.end(), 0) != blockSizes.end()) {
+        LogFailure(L"BenchmarkSequentialThroughput", L"--block-sizes entries must be non-zero");
+        return;
+    }
+
+    struct { DWORD value; const wchar_t* name; } flagSets[] = {
+        { 0, L"FILE_ATTRIBUTE_NORMAL" },
+        { FILE_FLAG_NO_BUFFERING, L"FILE_FLAG_NO_BUFFERING" },
+        { FILE_FLAG_SEQUENTIAL_SCAN, L"FILE_FLAG_SEQUENTIAL_SCAN" },
+        { FILE_FLAG_WRITE_THROUGH, L"FILE_FLAG_WRITE_THROUGH" },
+    };
+
+    std::wstring path = dir + L"\\Sequential.bin";
+    for (const auto& flags : flagSets) {
+        for (ULONGLONG blockSize : blockSizes) {
+            ULONGLONG blocks = std::max<ULONGLONG>(1, fileSize / blockSize);
+            std::wstring label = std::wstring(L"Flags=") + flags.name + L" Block=" + FormatSize(blockSize);
+
+            BYTE* buffer = (BYTE*)VirtualAlloc(nullptr, (SIZE_T)blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+            if (buffer == nullptr) {
+                LogFailure(L"VirtualAlloc", label + L" buffer allocation failed");
+                continue;
+            }
+            for (ULONGLONG i = 0; i < blockSize; ++i)
+                buffer[i] = (BYTE)(i * 31 + 7);
+
+            HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL | flags.value, nullptr);
+            if (h == INVALID_HANDLE_VALUE) {
+                LogFailure(L"CreateFileW", label + L" write open failed. Error: " + std::to_wstring(GetLastError()));
+                VirtualFree(buffer, 0, MEM_RELEASE);
+                continue;
+            }
+            double cpuStart = ProcessCpuSeconds();
+            LONGLONG start = QueryCounter();
+            ULONGLONG moved = 0;
+            for (ULONGLONG i = 0; i < blocks; ++i) {
+                DWORD written = 0;
+                if (!WriteFile(h, buffer, (DWORD)blockSize, &written, nullptr) || written != blockSize) {
+                    LogFailure(L"WriteFile", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                    break;
+                }
+                moved += written;
+            }
+            FlushFileBuffers(h);
+            CloseHandle(h);
+            PrintThroughput(L"WriteFile " + label, moved, CounterToSeconds(QueryCounter() - start),
+                            ProcessCpuSeconds() - cpuStart);
+            if (!(flags.value & FILE_FLAG_NO_BUFFERING) && !RewriteUncached(path, moved))
+                LogFailure(L"WriteFile", label + L" uncached rewrite failed, the read pass may hit the cache. Error: " +
+                                         std::to_wstring(GetLastError()));
+
+            h = CreateFileW(path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | flags.value, nullptr);
+            if (h == INVALID_HANDLE_VALUE) {
+                LogFailure(L"CreateFileW", label + L" read open failed. Error: " + std::to_wstring(GetLastError()));
+            } else {
+                cpuStart = ProcessCpuSeconds();
+                start = QueryCounter();
+                moved = 0;
+                for (;;) {
+                    DWORD read = 0;
+                    if (!ReadFile(h, buffer, (DWORD)blockSize, &read, nullptr)) {
+                        LogFailure(L"ReadFile", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                        break;
+                    }
+                    if (read == 0)
+                        break;
+                    moved += read;
+                }
+                CloseHandle(h);
+                PrintThroughput(L"ReadFile " + label, moved, CounterToSeconds(QueryCounter() - start),
+                                ProcessCpuSeconds() - cpuStart);
+            }
+
+            DeleteFileW(path.c_str());
+            VirtualFree(buffer, 0, MEM_RELEASE);
+        }
+    }
+}
+
+struct ConcurrentStart {
+    HANDLE start;
+    LPTHREAD_START_ROUTINE routine;
+    LPVOID param;
+};
+
+static DWORD WINAPI ConcurrentTrampoline(LPVOID param) {
+    ConcurrentStart* start = static_cast<ConcurrentStart*>(param);
+    WaitForSingleObject(start->start, INFINITE);
+    return start->routine(start->param);
+}
+
+// Starts one thread per parameter, releases them together and returns the
+// wall time until the last one has finished.
+double RunConcurrently(LPTHREAD_START_ROUTINE routine, const std::vector<LPVOID>& params) {
+    HANDLE startEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    std::vector<ConcurrentStart> starts(params.size());
+    std::vector<HANDLE> threads;
+    for (size_t i = 0; i < params.size(); ++i) {
+        starts[i] = { startEvent, routine, params[i] };
+        HANDLE t = CreateThread(nullptr, 0, ConcurrentTrampoline, &starts[i], 0, nullptr);
+        if (t != nullptr)
+            threads.push_back(t);
+        else
+            LogFailure(L"CreateThread", L"Failed to start benchmark thread. Error: " + std::to_wstring(GetLastError()));
+    }
+
+    LONGLONG start = QueryCounter();
+    SetEvent(startEvent);
+    for (HANDLE t : threads) {
+        WaitForSingleObject(t, INFINITE);
+        CloseHandle(t);
+    }
+    double seconds = CounterToSeconds(QueryCounter() - start);
+    CloseHandle(startEvent);
+    return seconds;
+}
+
+// Writes `size` bytes of non-zero data in 1 MiB blocks so that later reads hit
+// allocated extents rather than holes.
+bool CreateFilledFile(const std::wstring& path, ULONGLONG size) {
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+    std::vector<BYTE> block(1 << 20);
+    for (size_t i = 0; i < block.size(); ++i)
+        block[i] = (BYTE)(i * 31 + 7);
+    bool ok = true;
+    for (ULONGLONG done = 0; ok && done < size;) {
+        DWORD chunk = (DWORD)std::min<ULONGLONG>(block.size(), size - done);
+        DWORD written = 0;
+        ok = WriteFile(h, block.data(), chunk, &written, nullptr) && written == chunk;
+        done += written;
+    }
+    CloseHandle(h);
+    return ok;
+}
+
+// One queue-depth sweep point of the random I/O benchmark. Each completion
+// thread of the engine records into its own histogram and counter.
+struct RandomIoRun {
+    HANDLE file;
+    bool write;
+    DWORD blockSize;
+    ULONGLONG blockCount;
+    LONGLONG deadline;
+    std::vector<LatencyHistogram> latency;
+    std::vector<ULONGLONG> completed;
+    LONG volatile lastError = ERROR_SUCCESS;
+};
+
+struct RandomIoSlot {
+    RandomIoRun* run;
+    std::mt19937_64 rng;
+};
+
+bool SubmitRandomIo(AsyncIoContext* context) {
+    RandomIoSlot* slot = static_cast<RandomIoSlot*>(context->user);
+    RandomIoRun& run = *slot->run;
+    ULONGLONG offset = (slot->rng() % run.blockCount) * run.blockSize;
+    if (!SubmitAsyncIo(context, run.file, run.write, offset, run.blockSize)) {
+        InterlockedExchange(&run.lastError, (LONG)GetLastError());
+        return false;
+    }
+    return true;
+}
+
+void RandomIoCompleted(AsyncIoContext* context, DWORD error, DWORD, DWORD thread) {
+    RandomIoRun& run = *static_cast<RandomIoSlot*>(context->user)->run;
+    if (error != ERROR_SUCCESS) {
+        InterlockedExchange(&run.lastError, (LONG)error);
+        return;
+    }
+    RecordLatency(run.latency[thread], CounterToNanoseconds(QueryCounter() - context->submitted));
+    run.completed[thread]++;
+    if (run.lastError == ERROR_SUCCESS && QueryCounter() < run.deadline)
+        SubmitRandomIo(context);
+}
+
+// Keeps `queue-depths` block-aligned random reads, then writes, in flight
+// against a preallocated file for a fixed time per point. The file is opened
+// with FILE_FLAG_NO_BUFFERING so every operation reaches the target, and
+// completions are resubmitted straight from the async I/O engine's threads.
+void BenchmarkRandomIops(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG fileSize = GetBenchmarkSize(options, L"file-size", 1ULL << 30);
+    ULONGLONG seconds = GetBenchmarkCount(options, L"seconds", 5);
+    DWORD threads = (DWORD)std::max<ULONGLONG>(1, GetBenchmarkCount(options, L"threads", 2));
+    std::vector<ULONGLONG> blockSizes = GetBenchmarkSizeList(options, L"block-sizes", { 4 << 10, 16 << 10, 64 << 10 });
+    std::vector<ULONGLONG> queueDepths = GetBenchmarkSizeList(options, L"queue-depths", { 1, 4, 16, 64, 256 });
+    if (blockSizes.empty() || queueDepths.empty())
+        return;
+    if (std::find(blockSizes.begin(), blockSizes.end(), 0) != blockSizes.end() ||
+        std::find(queueDepths.begin(), queueDepths.end(), 0) != queueDepths.end()) {
+        LogFailure(L"BenchmarkRandomIops", L"--block-sizes and --queue-depths entries must be non-zero");
+        return;
+    }
+    ULONGLONG maxBlockSize = *std::max_element(blockSizes.begin(), blockSizes.end());
+    ULONGLONG maxDepth = *std::max_element(queueDepths.begin(), queueDepths.end());
+
+    std::wstring path = dir + L"\\RandomIops.bin";
+    if (!CreateFilledFile(path, fileSize)) {
+        LogFailure(L"WriteFile", L"Failed to preallocate " + path + L". Error: " + std::to_wstring(GetLastError()));
+        return;
+    }
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        LogFailure(L"CreateFileW", L"Failed to open " + path + L". Error: " + std::to_wstring(GetLastError()));
+        return;
+    }
+
+    AsyncIoEngine engine;
+    if (!StartAsyncIoEngine(engine, (DWORD)maxDepth, (DWORD)maxBlockSize, threads, RandomIoCompleted) ||
+        !AssociateAsyncIoFile(engine, h)) {
+        LogFailure(L"CreateIoCompletionPort", L"Failed to start the async I/O engine. Error: " +
+                                              std::to_wstring(GetLastError()));
+        StopAsyncIoEngine(engine);
+        CloseHandle(h);
+        return;
+    }
+    memset(engine.buffers, 0x5A, (size_t)(maxDepth * maxBlockSize));
+
+    for (int write = 0; write <= 1; ++write) {
+        for (ULONGLONG blockSize : blockSizes) {
+            for (ULONGLONG depth : queueDepths) {
+                std::wstring label = std::wstring(write ? L"WriteFile" : L"ReadFile") + L" Block=" +
+                                     FormatSize(blockSize) + L" QD=" + std::to_wstring(depth);
+
+                RandomIoRun run;
+                run.file = h;
+                run.write = write != 0;
+                run.blockSize = (DWORD)blockSize;
+                run.blockCount = std::max<ULONGLONG>(1, fileSize / blockSize);
+                run.latency.assign(threads, LatencyHistogram());
+                run.completed.assign(threads, 0);
+
+                std::vector<RandomIoSlot> slots((size_t)depth);
+                std::vector<AsyncIoContext*> contexts;
+                for (size_t i = 0; i < slots.size(); ++i) {
+                    slots[i].run = &run;
+                    slots[i].rng.seed(blockSize * 1000 + depth * 10 + i);
+                    AsyncIoContext* context = AcquireAsyncIoContext(engine);
+                    context->user = &slots[i];
+                    contexts.push_back(context);
+                }
+
+                LARGE_INTEGER frequency;
+                QueryPerformanceFrequency(&frequency);
+                LONGLONG start = QueryCounter();
+                run.deadline = start + (LONGLONG)seconds * frequency.QuadPart;
+                for (AsyncIoContext* context : contexts)
+                    if (!SubmitRandomIo(context))
+                        break;
+                WaitAsyncIoIdle(engine);
+                double elapsed = CounterToSeconds(QueryCounter() - start);
+                for (AsyncIoContext* context : contexts)
+                    ReleaseAsyncIoContext(context);
+
+                LatencyHistogram latency;
+                ULONGLONG completed = 0;
+                for (DWORD t = 0; t < threads; ++t) {
+                    MergeLatency(latency, run.latency[t]);
+                    completed += run.completed[t];
+                }
+                if (run.lastError != ERROR_SUCCESS)
+                    LogFailure(write ? L"WriteFile" : L"ReadFile",
+                               label + L" failed. Error: " + std::to_wstring(run.lastError));
+                wchar_t buffer[96];
+                swprintf_s(buffer, L"%.0f IOPS, %.1f MB/s", completed / elapsed,
+                           (double)(completed * blockSize) / 1e6 / elapsed);
+                std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+                PrintLatency(label, latency);
+            }
+        }
+    }
+
+    StopAsyncIoEngine(engine);
+    CloseHandle(h);
+    DeleteFileW(path.c_str());
+}
+
+enum MetadataPhase { METADATA_CREATE, METADATA_STAT, METADATA_DELETE };
+
+struct MetadataStormWorker {
+    const std::wstring* dir;
+    DWORD thread;
+    ULONGLONG files;
+    DWORD fileSize;
+    MetadataPhase phase;
+    LatencyHistogram latency;
+    ULONGLONG errors = 0;
+    DWORD lastError = ERROR_SUCCESS;
+};
+
+static DWORD WINAPI MetadataStormThread(LPVOID param) {
+    MetadataStormWorker& worker = *static_cast<MetadataStormWorker*>(param);
+    std::vector<char> content(worker.fileSize, 'x');
+    worker.latency = LatencyHistogram();
+    worker.errors = 0;
+    worker.lastError = ERROR_SUCCESS;
+    for (ULONGLONG i = 0; i < worker.files; ++i) {
+        std::wstring path = *worker.dir + L"\\t" + std::to_wstring(worker.thread) + L"-" + std::to_wstring(i) + L".txt";
+
+        LONGLONG start = QueryCounter();
+        bool ok = false;
+        DWORD error = ERROR_SUCCESS;
+        if (worker.phase == METADATA_CREATE) {
+            HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (h != INVALID_HANDLE_VALUE) {
+                DWORD written = 0;
+                ok = content.empty() || (WriteFile(h, content.data(), (DWORD)content.size(), &written, nullptr) &&
+                                         written == content.size());
+                error = GetLastError();
+                CloseHandle(h);
+            } else {
+                error = GetLastError();
+            }
+        } else if (worker.phase == METADATA_STAT) {
+            SetLastError(ERROR_SUCCESS);
+            ok = FileExistsAndSizeEquals(path, worker.fileSize);
+            error = GetLastError();
+        } else {
+            ok = DeleteFileW(path.c_str()) != FALSE;
+            error = GetLastError();
+        }
+        RecordLatency(worker.latency, CounterToNanoseconds(QueryCounter() - start));
+
+        if (!ok) {
+            worker.errors++;
+            // A stat that found the file with the wrong size leaves no error code.
+            worker.lastError = error != ERROR_SUCCESS ? error : ERROR_INVALID_DATA;
+        }
+    }
+    return 0;
+}
+
+// Has N threads create, stat and delete their own tiny files in one shared
+// directory, phase by phase, for each thread count. Creation uses CreateFileW
+// with CREATE_NEW, stat uses FileExistsAndSizeEquals and removal DeleteFileW,
+// the same primitives as the tests. Efficiency compares ops/s per thread with
+// the first thread count in the list.
+void BenchmarkMetadataStorm(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG files = GetBenchmarkCount(options, L"files", 10000);
+    DWORD fileSize = (DWORD)GetBenchmarkSize(options, L"file-size", 0);
+    std::vector<ULONGLONG> threadCounts = GetBenchmarkSizeList(options, L"threads", { 1, 2, 4, 8, 16 });
+
+    struct { MetadataPhase phase; const wchar_t* name; } phases[] = {
+        { METADATA_CREATE, L"CreateFileW" },
+        { METADATA_STAT, L"FindFirstFileW" },
+        { METADATA_DELETE, L"DeleteFileW" },
+    };
+    double baseline[3] = {};
+    ULONGLONG baselineThreads = 0;
+
+    for (ULONGLONG threadCount : threadCounts) {
+        if (threadCount == 0)
+            continue;
+        std::vector<MetadataStormWorker> workers((size_t)threadCount);
+        std::vector<LPVOID> params;
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].dir = &dir;
+            workers[t].thread = (DWORD)t;
+            workers[t].files = files;
+            workers[t].fileSize = fileSize;
+            params.push_back(&workers[t]);
+        }
+        if (baselineThreads == 0)
+            baselineThreads = threadCount;
+
+        for (int p = 0; p < 3; ++p) {
+            for (auto& worker : workers)
+                worker.phase = phases[p].phase;
+            double seconds = RunConcurrently(MetadataStormThread, params);
+
+            LatencyHistogram latency;
+            ULONGLONG errors = 0;
+            DWORD lastError = ERROR_SUCCESS;
+            for (const auto& worker : workers) {
+                MergeLatency(latency, worker.latency);
+                errors += worker.errors;
+                if (worker.errors != 0)
+                    lastError = worker.lastError;
+            }
+
+            double rate = (double)(latency.total - errors) / seconds;
+            if (threadCount == baselineThreads)
+                baseline[p] = rate;
+            double efficiency = baseline[p] > 0.0 ? rate / (baseline[p] * threadCount / baselineThreads) : 0.0;
+
+            std::wstring label = std::wstring(phases[p].name) + L" Threads=" + std::to_wstring(threadCount);
+            wchar_t buffer[96];
+            swprintf_s(buffer, L"%.0f ops/s, scaling efficiency %.0f%%", rate, efficiency * 100.0);
+            std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+            PrintLatency(label, latency);
+            if (errors != 0)
+                LogFailure(phases[p].name, label + L" " + std::to_wstring(errors) + L" operations failed. Error: " +
+                                           std::to_wstring(lastError));
+        }
+    }
+}
+
+struct PopulateWorker {
+    const std::wstring* dir;
+    ULONGLONG begin;
+    ULONGLONG end;
+    ULONGLONG errors = 0;
+};
+
+static DWORD WINAPI PopulateThread(LPVOID param) {
+    PopulateWorker& worker = *static_cast<PopulateWorker*>(param);
+    for (ULONGLONG i = worker.begin; i < worker.end; ++i) {
+        std::wstring path = *worker.dir + L"\\e" + std::to_wstring(i) + L".txt";
+        HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h == INVALID_HANDLE_VALUE)
+            worker.errors++;
+        else
+            CloseHandle(h);
+    }
+    return 0;
+}
+
+// Creates empty files e<begin>.txt .. e<end - 1>.txt in `dir` from `threads`
+// threads and returns how many could not be created.
+ULONGLONG PopulateDirectory(const std::wstring& dir, ULONGLONG begin, ULONGLONG end, DWORD threads) {
+    std::vector<PopulateWorker> workers(threads);
+    std::vector<LPVOID> params;
+    ULONGLONG share = (end - begin + threads - 1) / threads;
+    for (DWORD t = 0; t < threads; ++t) {
+        workers[t].dir = &dir;
+        workers[t].begin = std::min(end, begin + t * share);
+        workers[t].end = std::min(end, workers[t].begin + share);
+        params.push_back(&workers[t]);
+    }
+    RunConcurrently(PopulateThread, params);
+
+    ULONGLONG errors = 0;
+    for (const auto& worker : workers)
+        errors += worker.errors;
+    return errors;
+}
+
+bool IsDotEntry(const wchar_t* name, size_t length) {
+    return (length == 1 && name[0] == L'.') || (length == 2 && name[0] == L'.' && name[1] == L'.');
+}
+
+ULONGLONG EnumerateWithFindFirstFileW(const std::wstring& dir) {
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = FindFirstFileW((dir + L"\\*").c_str(), &data);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return 0;
+    ULONGLONG entries = 0;
+    do {
+        if (!IsDotEntry(data.cFileName, wcslen(data.cFileName)))
+            ++entries;
+    } while (FindNextFileW(hFind, &data));
+    FindClose(hFind);
+    return entries;
+}
+
+ULONGLONG EnumerateWithFindFirstFileExW(const std::wstring& dir) {
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = FindFirstFileExW((dir + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                    FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return 0;
+    ULONGLONG entries = 0;
+    do {
+        if (!IsDotEntry(data.cFileName, wcslen(data.cFileName)))
+            ++entries;
+    } while (FindNextFileW(hFind, &data));
+    FindClose(hFind);
+    return entries;
+}
+
+ULONGLONG EnumerateWithFileIdBothDirectoryInfo(const std::wstring& dir, DWORD bufferSize) {
+    HANDLE h = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return 0;
+
+    // FILE_ID_BOTH_DIR_INFO entries must be 8-byte aligned.
+    std::vector<ULONGLONG> buffer((bufferSize + sizeof(ULONGLONG) - 1) / sizeof(ULONGLONG));
+    ULONGLONG entries = 0;
+    FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+    while (GetFileInformationByHandleEx(h, infoClass, buffer.data(), (DWORD)(buffer.size() * sizeof(ULONGLONG)))) {
+        infoClass = FileIdBothDirectoryInfo;
+        const BYTE* entry = (const BYTE*)buffer.data();
+        for (;;) {
+            const FILE_ID_BOTH_DIR_INFO* info = (const FILE_ID_BOTH_DIR_INFO*)entry;
+            if (!IsDotEntry(info->FileName, info->FileNameLength / sizeof(WCHAR)))
+                ++entries;
+            if (info->NextEntryOffset == 0)
+                break;
+            entry += info->NextEntryOffset;
+        }
+    }
+    CloseHandle(h);
+    return entries;
+}
+
+// Grows one directory through the `entries` sizes and, at each size, times
+// full enumerations with FindFirstFileW/FindNextFileW, FindFirstFileExW with
+// FindExInfoBasic and FIND_FIRST_EX_LARGE_FETCH, and GetFileInformationByHandleEx
+// with FileIdBothDirectoryInfo. Reports entries/s of the median pass.
+void BenchmarkDirectoryEnumeration(const std::wstring& dir, const BenchmarkOptions& options) {
+    std::vector<ULONGLONG> sizes = GetBenchmarkSizeList(options, L"entries", { 1000, 10000, 100000 });
+    ULONGLONG passes = std::max<ULONGLONG>(1, GetBenchmarkCount(options, L"passes", 3));
+    DWORD bufferSize = (DWORD)GetBenchmarkSize(options, L"buffer-size", 64 << 10);
+    DWORD threads = (DWORD)std::max<ULONGLONG>(1, GetBenchmarkCount(options, L"populate-threads", 8));
+    std::sort(sizes.begin(), sizes.end());
+
+    std::wstring target = dir + L"\\Entries";
+    CreateDirectoryW(target.c_str(), nullptr);
+
+    struct { const wchar_t* name; int method; } methods[] = {
+        { L"FindFirstFileW", 0 },
+        { L"FindFirstFileExW FindExInfoBasic LARGE_FETCH", 1 },
+        { L"GetFileInformationByHandleEx FileIdBothDirectoryInfo", 2 },
+    };
+
+    ULONGLONG populated = 0, failed = 0;
+    for (ULONGLONG size : sizes) {
+        if (size > populated) {
+            ULONGLONG errors = PopulateDirectory(target, populated, size, threads);
+            if (errors != 0)
+                LogFailure(L"CreateFileW", L"Failed to create " + std::to_wstring(errors) + L" of " +
+                                           std::to_wstring(size - populated) + L" entries");
+            failed += errors;
+            populated = size;
+        }
+
+        for (const auto& method : methods) {
+            std::vector<double> times;
+            ULONGLONG seen = 0;
+            for (ULONGLONG pass = 0; pass < passes; ++pass) {
+                LONGLONG start = QueryCounter();
+                if (method.method == 0)
+                    seen = EnumerateWithFindFirstFileW(target);
+                else if (method.method == 1)
+                    seen = EnumerateWithFindFirstFileExW(target);
+                else
+                    seen = EnumerateWithFileIdBothDirectoryInfo(target, bufferSize);
+                times.push_back(CounterToSeconds(QueryCounter() - start));
+            }
+            std::sort(times.begin(), times.end());
+            double median = times[times.size() / 2];
+
+            std::wstring label = std::wstring(method.name) + L" Entries=" + std::to_wstring(size);
+            if (seen != populated - failed)
+                LogFailure(method.name, label + L" saw " + std::to_wstring(seen) + L" entries, expected " +
+                                        std::to_wstring(populated - failed));
+            wchar_t buffer[96];
+            swprintf_s(buffer, L"%.0f entries/s (%.1f ms per pass)", seen / median, median * 1000.0);
+            std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+        }
+    }
+}
+
+// Builds a tree `depth` levels deep where every directory holds `files`
+// empty files and, above the last level, `fanout` subdirectories.
+ULONGLONG BuildSyntheticTree(const std::wstring& path, DWORD fanout, DWORD depth, DWORD files) {
+    ULONGLONG errors = 0;
+    for (DWORD f = 0; f < files; ++f) {
+        std::wstring file = path + L"\\f" + std::to_wstring(f) + L".txt";
+        HANDLE h = CreateFileW(file.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h == INVALID_HANDLE_VALUE)
+            errors++;
+        else
+            CloseHandle(h);
+    }
+    if (depth <= 1)
+        return errors;
+    for (DWORD d = 0; d < fanout; ++d) {
+        std::wstring child = path + L"\\d" + std::to_wstring(d);
+        if (!CreateDirectoryW(child.c_str(), nullptr))
+            errors++;
+        else
+            errors += BuildSyntheticTree(child, fanout, depth - 1, files);
+    }
+    return errors;
+}
+
+static void CountTreeEntry(const std::wstring&, const WIN32_FIND_DATAW&, DWORD, void*) {
+    // Walk cost only; WalkTree already counts the entries.
+}
+
+// Crawls a wide tree (one level of many directories) and a deep one (binary
+// fanout) with the parallel tree walker at each thread count and reports
+// files/s, then times RemoveDirectoryTreeParallel on each tree.
+void BenchmarkTreeWalk(const std::wstring& dir, const BenchmarkOptions& options) {
+    DWORD width = (DWORD)GetBenchmarkCount(options, L"width", 1000);
+    DWORD depth = (DWORD)GetBenchmarkCount(options, L"depth", 10);
+    DWORD files = (DWORD)GetBenchmarkCount(options, L"files", 10);
+    std::vector<ULONGLONG> threadCounts = GetBenchmarkSizeList(options, L"threads", { 1, 2, 4, 8, 16 });
+    if (threadCounts.empty())
+        return;
+
+    struct { const wchar_t* name; DWORD fanout; DWORD depth; } shapes[] = {
+        { L"Wide", width, 2 },
+        { L"Deep", 2, depth },
+    };
+
+    for (const auto& shape : shapes) {
+        std::wstring root = dir + L"\\" + shape.name;
+        CreateDirectoryW(root.c_str(), nullptr);
+        ULONGLONG errors = BuildSyntheticTree(root, shape.fanout, shape.depth, files);
+        if (errors != 0)
+            LogFailure(L"CreateFileW", std::wstring(shape.name) + L" tree is missing " + std::to_wstring(errors) +
+                                       L" entries");
+
+        TreeWalkStats expected;
+        for (ULONGLONG threadCount : threadCounts) {
+            LONGLONG start = QueryCounter();
+            TreeWalkStats stats = WalkTree(root, (DWORD)threadCount, CountTreeEntry, nullptr);
+            double seconds = CounterToSeconds(QueryCounter() - start);
+
+            std::wstring label = std::wstring(L"WalkTree ") + shape.name + L" Threads=" + std::to_wstring(threadCount);
+            if (expected.files == 0 && expected.directories == 0)
+                expected = stats;
+            else if (stats.files != expected.files || stats.directories != expected.directories)
+                LogFailure(L"WalkTree", label + L" saw a different tree than the first walk");
+            wchar_t buffer[128];
+            swprintf_s(buffer, L"%llu files, %llu directories, %.0f files/s", stats.files, stats.directories,
+                       stats.files / seconds);
+            std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+        }
+
+        LONGLONG start = QueryCounter();
+        RemoveDirectoryTreeParallel(root, (DWORD)threadCounts.back());
+        double seconds = CounterToSeconds(QueryCounter() - start);
+        wchar_t buffer[96];
+        swprintf_s(buffer, L"%.0f entries/s", (expected.files + expected.directories) / seconds);
+        std::wcout << L"[BENCH] RemoveDirectoryTreeParallel " << shape.name << L" Threads=" << threadCounts.back()
+                   << L": " << buffer << std::endl;
+    }
+}
+
+// COPYFILE2_EXTENDED_PARAMETERS_V2 (Windows 11 22H2) adds ioDesiredSize, the
+// chunk size CopyFile2 should use. Declared here because older SDKs and
+// mingw-w64 lack it; CopyFile2 tells the versions apart by dwSize.
+struct CopyFile2ParametersV2 {
+    DWORD dwSize;
+    DWORD dwCopyFlags;
+    BOOL* pfCancel;
+    PCOPYFILE2_PROGRESS_ROUTINE pProgressRoutine;
+    PVOID pvCallbackContext;
+    DWORD dwCopyFlagsV2;
+    ULONG ioDesiredSize;
+    ULONG ioDesiredRate;
+    PVOID reserved[8];
+};
+
+// Start of a copy and the moment its first chunk was reported written.
+struct CopyTiming {
+    LONGLONG start;
+    LONGLONG firstByte;
+};
+
+static DWORD CALLBACK CopyFileExProgress(LARGE_INTEGER, LARGE_INTEGER totalBytesTransferred, LARGE_INTEGER,
+                                         LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID data) {
+    CopyTiming* timing = static_cast<CopyTiming*>(data);
+    if (timing->firstByte == 0 && totalBytesTransferred.QuadPart > 0)
+        timing->firstByte = QueryCounter();
+    return PROGRESS_CONTINUE;
+}
+
+static COPYFILE2_MESSAGE_ACTION CALLBACK CopyFile2Progress(const COPYFILE2_MESSAGE* message, PVOID context) {
+    CopyTiming* timing = static_cast<CopyTiming*>(context);
+    if (timing->firstByte == 0 && message->Type == COPYFILE2_CALLBACK_CHUNK_FINISHED)
+        timing->firstByte = QueryCounter();
+    return COPYFILE2_PROGRESS_CONTINUE;
+}
+
+// Copies with two buffers in flight: the read of chunk k + 1 overlaps the
+// write of chunk k. Both handles bypass the cache, so the tail is written
+// sector-padded and the destination trimmed to size afterwards.
+bool PipelinedCopy(const std::wstring& source, const std::wstring& destination, DWORD chunkSize, CopyTiming& timing) {
+    HANDLE in = CreateFileW(source.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (in == INVALID_HANDLE_VALUE)
+        return false;
+    HANDLE out = CreateFileW(destination.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, nullptr);
+    if (out == INVALID_HANDLE_VALUE) {
+        CloseHandle(in);
+        return false;
+    }
+
+    BYTE* buffers = (BYTE*)VirtualAlloc(nullptr, (SIZE_T)chunkSize * 2, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    OVERLAPPED reads[2] = {}, writes[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        reads[i].hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        writes[i].hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    }
+
+    auto issue = [](HANDLE h, bool write, BYTE* buffer, DWORD length, ULONGLONG offset, OVERLAPPED& overlapped) {
+        ResetEvent(overlapped.hEvent);
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        BOOL ok = write ? WriteFile(h, buffer, length, nullptr, &overlapped)
+                        : ReadFile(h, buffer, length, nullptr, &overlapped);
+        return ok || GetLastError() == ERROR_IO_PENDING;
+    };
+
+    // A read issued at end of file may fail at once with ERROR_HANDLE_EOF
+    // instead of completing with zero bytes; that ends the stream.
+    bool ok = buffers != nullptr;
+    bool atEnd = false;
+    if (ok && !issue(in, false, buffers, chunkSize, 0, reads[0])) {
+        atEnd = GetLastError() == ERROR_HANDLE_EOF;
+        ok = atEnd;
+    }
+    bool writePending[2] = { false, false };
+    ULONGLONG offset = 0, copied = 0;
+    for (int k = 0; ok && !atEnd; k ^= 1) {
+        DWORD read = 0;
+        if (!GetOverlappedResult(in, &reads[k], &read, TRUE)) {
+            ok = GetLastError() == ERROR_HANDLE_EOF;
+            break;
+        }
+        if (read == 0)
+            break;
+
+        // The other buffer is free once its write has completed.
+        DWORD written = 0;
+        if (writePending[k ^ 1]) {
+            ok = GetOverlappedResult(out, &writes[k ^ 1], &written, TRUE) != FALSE;
+            writePending[k ^ 1] = false;
+        }
+        // A short read was the last chunk; otherwise start the next one now.
+        if (ok && read == chunkSize &&
+            !issue(in, false, buffers + (k ^ 1) * (SIZE_T)chunkSize, chunkSize, offset + read, reads[k ^ 1])) {
+            atEnd = GetLastError() == ERROR_HANDLE_EOF;
+            ok = atEnd;
+        }
+
+        // Unbuffered writes must cover whole sectors; the file is trimmed below.
+        DWORD length = (read + 4095) & ~4095u;
+        ok = ok && issue(out, true, buffers + k * (SIZE_T)chunkSize, length, offset, writes[k]);
+        writePending[k] = ok;
+        if (ok && timing.firstByte == 0) {
+            ok = GetOverlappedResult(out, &writes[k], &written, TRUE) != FALSE;
+            writePending[k] = false;
+            timing.firstByte = QueryCounter();
+        }
+        offset += read;
+        copied += read;
+        if (read < chunkSize || atEnd)
+            break;
+    }
+    for (int i = 0; i < 2; ++i) {
+        DWORD written = 0;
+        if (writePending[i] && !GetOverlappedResult(out, &writes[i], &written, TRUE))
+            ok = false;
+    }
+
+    if (ok) {
+        FILE_END_OF_FILE_INFO eof;
+        eof.EndOfFile.QuadPart = (LONGLONG)copied;
+        ok = SetFileInformationByHandle(out, FileEndOfFileInfo, &eof, sizeof(eof)) != FALSE;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        CloseHandle(reads[i].hEvent);
+        CloseHandle(writes[i].hEvent);
+    }
+    if (buffers != nullptr)
+        VirtualFree(buffers, 0, MEM_RELEASE);
+    CloseHandle(out);
+    CloseHandle(in);
+    return ok;
+}
+
+void PrintCopyResult(const std::wstring& label, ULONGLONG bytes, double seconds, const CopyTiming& timing) {
+    wchar_t buffer[160];
+    if (timing.firstByte != 0)
+        swprintf_s(buffer, L"%.1f MB/s, %.2f s, time to first byte %.2f ms", (double)bytes / 1e6 / seconds, seconds,
+                   CounterToSeconds(timing.firstByte - timing.start) * 1000.0);
+    else
+        swprintf_s(buffer, L"%.1f MB/s, %.2f s, time to first byte n/a", (double)bytes / 1e6 / seconds, seconds);
+    std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+}
+
+// Copies files of each size with CopyFileW, CopyFileExW + COPY_FILE_NO_BUFFERING,
+// CopyFile2 at each chunk size and the in-harness pipelined copy. The source
+// is rewritten uncached before every copy so each one starts cold. Time to
+// first byte comes from the progress callbacks; CopyFileW has none.
+void BenchmarkCopy(const std::wstring& dir, const BenchmarkOptions& options) {
+    std::vector<ULONGLONG> sizes = GetBenchmarkSizeList(options, L"sizes", { 1 << 20, 64 << 20, 1ULL << 30 });
+    std::vector<ULONGLONG> chunkSizes = GetBenchmarkSizeList(options, L"chunk-sizes", { 64 << 10, 1 << 20, 8 << 20 });
+    DWORD pipelineChunk = (DWORD)GetBenchmarkSize(options, L"pipeline-chunk", 1 << 20);
+
+    std::wstring source = dir + L"\\CopySource.bin";
+    std::wstring destination = dir + L"\\CopyDestination.bin";
+    for (ULONGLONG size : sizes) {
+        if (!CreateFilledFile(source, size)) {
+            LogFailure(L"WriteFile", L"Failed to create copy source of " + FormatSize(size));
+            continue;
+        }
+        std::wstring suffix = L" Size=" + FormatSize(size);
+        auto coldSource = [&] {
+            if (!RewriteUncached(source, size))
+                LogFailure(L"WriteFile", L"Uncached rewrite of the copy source failed" + suffix + L". Error: " +
+                                         std::to_wstring(GetLastError()));
+        };
+
+        coldSource();
+        CopyTiming timing = { QueryCounter(), 0 };
+        if (CopyFileW(source.c_str(), destination.c_str(), FALSE))
+            PrintCopyResult(L"CopyFileW" + suffix, size, CounterToSeconds(QueryCounter() - timing.start), timing);
+        else
+            LogFailure(L"CopyFileW", suffix + L" failed. Error: " + std::to_wstring(GetLastError()));
+        DeleteFileW(destination.c_str());
+
+        coldSource();
+        timing = { QueryCounter(), 0 };
+        if (CopyFileExW(source.c_str(), destination.c_str(), CopyFileExProgress, &timing, nullptr,
+                        COPY_FILE_NO_BUFFERING))
+            PrintCopyResult(L"CopyFileExW COPY_FILE_NO_BUFFERING" + suffix, size,
+                            CounterToSeconds(QueryCounter() - timing.start), timing);
+        else
+            LogFailure(L"CopyFileExW", suffix + L" failed. Error: " + std::to_wstring(GetLastError()));
+        DeleteFileW(destination.c_str());
+
+        for (ULONGLONG chunk : chunkSizes) {
+            CopyFile2ParametersV2 params = {};
+            params.dwSize = sizeof(params);
+            params.pProgressRoutine = CopyFile2Progress;
+            params.pvCallbackContext = &timing;
+            params.ioDesiredSize = (ULONG)chunk;
+
+            coldSource();
+            timing = { QueryCounter(), 0 };
+            HRESULT hr = CopyFile2(source.c_str(), destination.c_str(), (COPYFILE2_EXTENDED_PARAMETERS*)&params);
+            std::wstring label = L"CopyFile2 Chunk=" + FormatSize(chunk) + suffix;
+            if (hr == E_INVALIDARG) {
+                // No V2 parameters before Windows 11 22H2: measure default chunking once.
+                COPYFILE2_EXTENDED_PARAMETERS v1 = {};
+                v1.dwSize = sizeof(v1);
+                v1.pProgressRoutine = CopyFile2Progress;
+                v1.pvCallbackContext = &timing;
+                coldSource();
+                timing = { QueryCounter(), 0 };
+                hr = CopyFile2(source.c_str(), destination.c_str(), &v1);
+                label = L"CopyFile2 Chunk=default" + suffix;
+            }
+            if (SUCCEEDED(hr))
+                PrintCopyResult(label, size, CounterToSeconds(QueryCounter() - timing.start), timing);
+            else
+                LogFailure(L"CopyFile2", label + L" failed. HRESULT: " + std::to_wstring((long)hr));
+            DeleteFileW(destination.c_str());
+            if (label.find(L"Chunk=default") != std::wstring::npos)
+                break;
+        }
+
+        coldSource();
+        timing = { QueryCounter(), 0 };
+        if (PipelinedCopy(source, destination, pipelineChunk, timing))
+            PrintCopyResult(L"PipelinedCopy Chunk=" + FormatSize(pipelineChunk) + suffix, size,
+                            CounterToSeconds(QueryCounter() - timing.start), timing);
+        else
+            LogFailure(L"PipelinedCopy", suffix + L" failed. Error: " + std::to_wstring(GetLastError()));
+        DeleteFileW(destination.c_str());
+        DeleteFileW(source.c_str());
+    }
+}
+
+// Renames through an open handle with FILE_RENAME_INFO and a full target path,
+// as SetFileInformationByHandleRenameFile does with a leaf name.
+bool RenameByHandle(const std::wstring& from, const std::wstring& to) {
+    HANDLE h = CreateFileW(from.c_str(), DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    std::vector<BYTE> buffer(sizeof(FILE_RENAME_INFO) + (to.size() + 1) * sizeof(wchar_t));
+    auto* info = reinterpret_cast<FILE_RENAME_INFO*>(buffer.data());
+    info->ReplaceIfExists = FALSE;
+    info->RootDirectory = nullptr;
+    info->FileNameLength = (DWORD)(to.size() * sizeof(wchar_t));
+    memcpy(info->FileName, to.c_str(), (to.size() + 1) * sizeof(wchar_t));
+
+    BOOL ok = SetFileInformationByHandle(h, FileRenameInfo, info, (DWORD)buffer.size());
+    DWORD error = GetLastError();
+    CloseHandle(h);
+    SetLastError(error);
+    return ok != FALSE;
+}
+
+// Creates `path` and any missing parents.
+void CreateDirectoryPath(const std::wstring& path) {
+    for (size_t slash = path.find(L'\\', 3); slash != std::wstring::npos; slash = path.find(L'\\', slash + 1))
+        CreateDirectoryW(path.substr(0, slash).c_str(), nullptr);
+    CreateDirectoryW(path.c_str(), nullptr);
+}
+
+// Times renames of `files` empty files with MoveFileW, MoveFileExW and
+// FILE_RENAME_INFO within one directory, across sibling directories and across
+// two deep trees; the FILE_RENAME_INFO figure includes opening and closing the
+// handle it needs. Then moves a directory between two parents while it grows
+// through the `children` counts, like MoveFileWDirectoryMoveBasic at scale.
+void BenchmarkRename(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG files = GetBenchmarkCount(options, L"files", 2000);
+    DWORD treeDepth = (DWORD)GetBenchmarkCount(options, L"tree-depth", 16);
+    ULONGLONG moves = std::max<ULONGLONG>(1, GetBenchmarkCount(options, L"moves", 5));
+    std::vector<ULONGLONG> childCounts = GetBenchmarkSizeList(options, L"children", { 0, 10, 100, 1000, 10000, 100000 });
+
+    std::wstring deepPath;
+    for (DWORD level = 0; level < treeDepth; ++level)
+        deepPath += L"\\l" + std::to_wstring(level);
+
+    struct { const wchar_t* name; std::wstring from; std::wstring to; } cases[] = {
+        { L"SameDirectory", dir + L"\\Same", dir + L"\\Same" },
+        { L"CrossDirectory", dir + L"\\CrossA", dir + L"\\CrossB" },
+        { L"DeepTree", dir + L"\\DeepA" + deepPath, dir + L"\\DeepB" + deepPath },
+    };
+    const wchar_t* methods[] = { L"MoveFileW", L"MoveFileExW", L"FileRenameInfo" };
+
+    for (const auto& c : cases) {
+        CreateDirectoryPath(c.from);
+        CreateDirectoryPath(c.to);
+        for (int method = 0; method < 3; ++method) {
+            ULONGLONG failed = PopulateDirectory(c.from, 0, files, 1);
+            LatencyHistogram latency;
+            ULONGLONG errors = failed;
+            DWORD lastError = ERROR_SUCCESS;
+
+            LONGLONG begin = QueryCounter();
+            for (ULONGLONG i = 0; i < files; ++i) {
+                std::wstring from = c.from + L"\\e" + std::to_wstring(i) + L".txt";
+                std::wstring to = c.to + L"\\r" + std::to_wstring(i) + L".txt";
+                LONGLONG start = QueryCounter();
+                BOOL ok = method == 0 ? MoveFileW(from.c_str(), to.c_str())
+                        : method == 1 ? MoveFileExW(from.c_str(), to.c_str(), 0)
+                                      : RenameByHandle(from, to);
+                RecordLatency(latency, CounterToNanoseconds(QueryCounter() - start));
+                if (!ok) {
+                    errors++;
+                    lastError = GetLastError();
+                }
+            }
+            double seconds = CounterToSeconds(QueryCounter() - begin);
+
+            std::wstring label = std::wstring(methods[method]) + L" " + c.name;
+            wchar_t buffer[64];
+            swprintf_s(buffer, L"%.0f renames/s", files / seconds);
+            std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+            PrintLatency(label, latency);
+            if (errors != 0)
+                LogFailure(methods[method], label + L" " + std::to_wstring(errors) + L" renames failed. Error: " +
+                                            std::to_wstring(lastError));
+
+            for (ULONGLONG i = 0; i < files; ++i)
+                DeleteFileW((c.to + L"\\r" + std::to_wstring(i) + L".txt").c_str());
+        }
+    }
+
+    // Directory moves: the directory shuttles between two parents.
+    std::wstring parents[2] = { dir + L"\\MoveParentA", dir + L"\\MoveParentB" };
+    CreateDirectoryW(parents[0].c_str(), nullptr);
+    CreateDirectoryW(parents[1].c_str(), nullptr);
+    std::wstring moving = parents[0] + L"\\Moving";
+    CreateDirectoryW(moving.c_str(), nullptr);
+    int side = 0;
+    ULONGLONG populated = 0;
+    std::sort(childCounts.begin(), childCounts.end());
+    for (ULONGLONG children : childCounts) {
+        if (children > populated) {
+            if (PopulateDirectory(parents[side] + L"\\Moving", populated, children, 8) != 0)
+                LogFailure(L"CreateFileW", L"Failed to populate directory with " + std::to_wstring(children) +
+                                           L" children");
+            populated = children;
+        }
+
+        std::vector<double> times;
+        for (ULONGLONG m = 0; m < moves; ++m) {
+            std::wstring from = parents[side] + L"\\Moving";
+            std::wstring to = parents[side ^ 1] + L"\\Moving";
+            LONGLONG start = QueryCounter();
+            if (!MoveFileW(from.c_str(), to.c_str())) {
+                LogFailure(L"MoveFileW", L"Directory move with " + std::to_wstring(children) +
+                                         L" children failed. Error: " + std::to_wstring(GetLastError()));
+                break;
+            }
+            times.push_back(CounterToSeconds(QueryCounter() - start));
+            side ^= 1;
+        }
+        if (times.empty())
+            continue;
+        std::sort(times.begin(), times.end());
+        wchar_t buffer[96];
+        swprintf_s(buffer, L"median %.2f ms, max %.2f ms over %zu moves", times[times.size() / 2] * 1000.0,
+                   times.back() * 1000.0, times.size());
+        std::wcout << L"[BENCH] MoveFileW Directory Children=" << children << L": " << buffer << std::endl;
+    }
+}
+
+bool LockRange(HANDLE h, ULONGLONG offset, DWORD length) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    return LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, length, 0, &overlapped) != FALSE;
+}
+
+bool UnlockRange(HANDLE h, ULONGLONG offset, DWORD length) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    return UnlockFileEx(h, 0, length, 0, &overlapped) != FALSE;
+}
+
+// One thread of the lock benchmark, on its own handle to the shared file.
+// Uncontended workers lock a private range; contended ones all lock range 0
+// and hold it for holdTicks before releasing.
+struct LockWorker {
+    HANDLE file;
+    DWORD thread;
+    bool contended;
+    ULONGLONG iterations;
+    LONGLONG deadline;
+    LONGLONG holdTicks;
+    LatencyHistogram latency;
+    ULONGLONG acquired = 0;
+    ULONGLONG errors = 0;
+    DWORD lastError = ERROR_SUCCESS;
+};
+
+static DWORD WINAPI LockBenchmarkThread(LPVOID param) {
+    LockWorker& worker = *static_cast<LockWorker*>(param);
+    ULONGLONG offset = worker.contended ? 0 : (ULONGLONG)worker.thread * 4096;
+    for (ULONGLONG i = 0; worker.contended ? QueryCounter() < worker.deadline : i < worker.iterations; ++i) {
+        LONGLONG start = QueryCounter();
+        if (!LockRange(worker.file, offset, 4096)) {
+            worker.errors++;
+            worker.lastError = GetLastError();
+            continue;
+        }
+        LONGLONG locked = QueryCounter();
+        RecordLatency(worker.latency, CounterToNanoseconds(locked - start));
+        worker.acquired++;
+
+        while (worker.holdTicks != 0 && QueryCounter() - locked < worker.holdTicks)
+            YieldProcessor();
+        if (!UnlockRange(worker.file, offset, 4096)) {
+            worker.errors++;
+            worker.lastError = GetLastError();
+        }
+    }
+    return 0;
+}
+
+// Runs LockWorkers on `threads` handles to `path` and returns the wall time.
+double RunLockWorkers(const std::wstring& path, std::vector<LockWorker>& workers) {
+    std::vector<LPVOID> params;
+    for (auto& worker : workers) {
+        worker.file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (worker.file == INVALID_HANDLE_VALUE) {
+            LogFailure(L"CreateFileW", L"Failed to open lock file. Error: " + std::to_wstring(GetLastError()));
+            continue;
+        }
+        params.push_back(&worker);
+    }
+    double seconds = RunConcurrently(LockBenchmarkThread, params);
+    for (auto& worker : workers)
+        if (worker.file != INVALID_HANDLE_VALUE)
+            CloseHandle(worker.file);
+    return seconds;
+}
+
+// Three byte-range lock scenarios on one file:
+//  - N threads with their own handles lock and unlock private 4K ranges;
+//  - one handle grows its lock table to `table-size` one-byte locks, with the
+//    cost of each lock and unlock reported per decade of table size;
+//  - N threads contend for the same range with blocking LockFileEx, holding it
+//    for `hold-us`; acquisition latency plus per-thread share and Jain's
+//    fairness index show whether waiters are served evenly.
+void BenchmarkLocks(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG iterations = GetBenchmarkCount(options, L"iterations", 10000);
+    ULONGLONG tableSize = GetBenchmarkCount(options, L"table-size", 100000);
+    ULONGLONG seconds = GetBenchmarkCount(options, L"seconds", 5);
+    ULONGLONG holdMicroseconds = GetBenchmarkCount(options, L"hold-us", 10);
+    std::vector<ULONGLONG> threadCounts = GetBenchmarkSizeList(options, L"threads", { 1, 2, 4, 8, 16 });
+
+    std::wstring path = dir + L"\\Locks.bin";
+    WriteDummyContent(path);
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    double baseline = 0.0;
+    ULONGLONG baselineThreads = 0;
+    for (ULONGLONG threadCount : threadCounts) {
+        std::vector<LockWorker> workers((size_t)threadCount);
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].thread = (DWORD)t;
+            workers[t].contended = false;
+            workers[t].iterations = iterations;
+            workers[t].holdTicks = 0;
+        }
+        double elapsed = RunLockWorkers(path, workers);
+
+        LatencyHistogram latency;
+        ULONGLONG errors = 0;
+        for (const auto& worker : workers) {
+            MergeLatency(latency, worker.latency);
+            errors += worker.errors;
+        }
+        double rate = latency.total / elapsed;
+        if (baselineThreads == 0) {
+            baseline = rate;
+            baselineThreads = threadCount;
+        }
+        std::wstring label = L"LockFileEx Private Threads=" + std::to_wstring(threadCount);
+        wchar_t buffer[96];
+        swprintf_s(buffer, L"%.0f lock/unlock pairs/s, scaling efficiency %.0f%%", rate,
+                   baseline > 0.0 ? rate / (baseline * threadCount / baselineThreads) * 100.0 : 0.0);
+        std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+        PrintLatency(label, latency);
+        if (errors != 0)
+            LogFailure(L"LockFileEx", label + L" " + std::to_wstring(errors) + L" lock operations failed");
+    }
+
+    // Lock table growth on a single handle.
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        LogFailure(L"CreateFileW", L"Failed to open lock file. Error: " + std::to_wstring(GetLastError()));
+        return;
+    }
+    for (int unlock = 0; unlock <= 1; ++unlock) {
+        LatencyHistogram latency;
+        ULONGLONG decade = 1000, bucketStart = 0;
+        for (ULONGLONG i = 0; i < tableSize; ++i) {
+            LONGLONG start = QueryCounter();
+            bool ok = unlock ? UnlockRange(h, i, 1) : LockRange(h, i, 1);
+            RecordLatency(latency, CounterToNanoseconds(QueryCounter() - start));
+            if (!ok) {
+                LogFailure(unlock ? L"UnlockFileEx" : L"LockFileEx",
+                           L"Failed at lock " + std::to_wstring(i) + L". Error: " + std::to_wstring(GetLastError()));
+                break;
+            }
+            if (i + 1 == decade || i + 1 == tableSize) {
+                PrintLatency(std::wstring(unlock ? L"UnlockFileEx" : L"LockFileEx") + L" Table=" +
+                             std::to_wstring(bucketStart) + L"-" + std::to_wstring(i + 1), latency);
+                latency = LatencyHistogram();
+                bucketStart = i + 1;
+                decade *= 10;
+            }
+        }
+    }
+    CloseHandle(h);
+
+    // Contended acquisition of one range.
+    for (ULONGLONG threadCount : threadCounts) {
+        std::vector<LockWorker> workers((size_t)threadCount);
+        LONGLONG deadline = QueryCounter() + (LONGLONG)seconds * frequency.QuadPart;
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].thread = (DWORD)t;
+            workers[t].contended = true;
+            workers[t].deadline = deadline;
+            workers[t].holdTicks = (LONGLONG)(holdMicroseconds * frequency.QuadPart / 1000000);
+        }
+        double elapsed = RunLockWorkers(path, workers);
+
+        LatencyHistogram latency;
+        double sum = 0.0, sumSquares = 0.0;
+        ULONGLONG fewest = ~0ULL, most = 0;
+        for (const auto& worker : workers) {
+            MergeLatency(latency, worker.latency);
+            sum += (double)worker.acquired;
+            sumSquares += (double)worker.acquired * (double)worker.acquired;
+            fewest = std::min(fewest, worker.acquired);
+            most = std::max(most, worker.acquired);
+        }
+        std::wstring label = L"LockFileEx Contended Threads=" + std::to_wstring(threadCount);
+        wchar_t buffer[160];
+        swprintf_s(buffer, L"%.0f acquisitions/s, per thread min %llu max %llu, fairness %.3f", sum / elapsed, fewest,
+                   most, sumSquares > 0.0 ? sum * sum / (threadCount * sumSquares) : 0.0);
+        std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+        PrintLatency(label, latency);
+    }
+    DeleteFileW(path.c_str());
+}
+
+enum GrowMethod { GROW_APPEND, GROW_SET_END_OF_FILE, GROW_ALLOCATION_INFO };
+
+// Grows an empty file to `size` bytes with the given method. `buffer` holds
+// `blockSize` bytes for the appending method.
+bool GrowFile(HANDLE h, GrowMethod method, ULONGLONG size, const BYTE* buffer, DWORD blockSize) {
+    if (method == GROW_APPEND) {
+        for (ULONGLONG done = 0; done < size; done += blockSize) {
+            DWORD written = 0;
+            if (!WriteFile(h, buffer, blockSize, &written, nullptr) || written != blockSize)
+                return false;
+        }
+        return true;
+    }
+    if (method == GROW_SET_END_OF_FILE) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        return SetFilePointerEx(h, end, nullptr, FILE_BEGIN) && SetEndOfFile(h);
+    }
+    FILE_ALLOCATION_INFO allocation;
+    allocation.AllocationSize.QuadPart = (LONGLONG)size;
+    return SetFileInformationByHandle(h, FileAllocationInfo, &allocation, sizeof(allocation)) != FALSE;
+}
+
+// Grows a file to `file-size` by appending, by one SetEndOfFile jump and by
+// FileAllocationInfo preallocation, then times sequential and random unbuffered
+// writes into the grown space. Each pass keeps its handle open throughout
+// because NTFS trims allocation past end of file when the last handle closes.
+void BenchmarkPreallocation(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG fileSize = GetBenchmarkSize(options, L"file-size", 1ULL << 30);
+    DWORD blockSize = (DWORD)GetBenchmarkSize(options, L"block-size", 1 << 20);
+    DWORD randomBlock = (DWORD)GetBenchmarkSize(options, L"random-block", 4 << 10);
+    ULONGLONG randomWrites = GetBenchmarkCount(options, L"random-writes", 20000);
+    if (blockSize == 0 || randomBlock == 0) {
+        LogFailure(L"BenchmarkPreallocation", L"--block-size and --random-block must be non-zero");
+        return;
+    }
+    fileSize = std::max<ULONGLONG>(blockSize, fileSize / blockSize * blockSize);
+
+    struct { GrowMethod method; const wchar_t* name; } methods[] = {
+        { GROW_APPEND, L"Append" },
+        { GROW_SET_END_OF_FILE, L"SetEndOfFile" },
+        { GROW_ALLOCATION_INFO, L"FileAllocationInfo" },
+    };
+
+    BYTE* buffer = (BYTE*)VirtualAlloc(nullptr, blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (buffer == nullptr) {
+        LogFailure(L"VirtualAlloc", L"Buffer allocation failed");
+        return;
+    }
+    memset(buffer, 0x5A, blockSize);
+
+    std::wstring path = dir + L"\\Preallocated.bin";
+    for (const auto& method : methods) {
+        for (int random = 0; random <= 1; ++random) {
+            HANDLE h = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+            if (h == INVALID_HANDLE_VALUE) {
+                LogFailure(L"CreateFileW", L"Failed to create " + path + L". Error: " + std::to_wstring(GetLastError()));
+                continue;
+            }
+
+            std::wstring label = std::wstring(method.name) + L" Size=" + FormatSize(fileSize);
+            LONGLONG start = QueryCounter();
+            bool grown = GrowFile(h, method.method, fileSize, buffer, blockSize);
+            double growSeconds = CounterToSeconds(QueryCounter() - start);
+            if (!grown) {
+                LogFailure(method.name, label + L" growth failed. Error: " + std::to_wstring(GetLastError()));
+                CloseHandle(h);
+                DeleteFileW(path.c_str());
+                continue;
+            }
+            if (!random) {
+                wchar_t growth[64];
+                swprintf_s(growth, L"grown in %.3f s", growSeconds);
+                std::wcout << L"[BENCH] " << label << L": " << growth << std::endl;
+            }
+
+            LARGE_INTEGER zero = {};
+            SetFilePointerEx(h, zero, nullptr, FILE_BEGIN);
+            std::mt19937_64 rng(fileSize);
+            ULONGLONG blocks = fileSize / randomBlock;
+            ULONGLONG operations = random ? randomWrites : fileSize / blockSize;
+            DWORD length = random ? randomBlock : blockSize;
+            ULONGLONG written = 0;
+
+            start = QueryCounter();
+            for (ULONGLONG i = 0; i < operations; ++i) {
+                if (random) {
+                    LARGE_INTEGER offset;
+                    offset.QuadPart = (LONGLONG)((rng() % blocks) * randomBlock);
+                    SetFilePointerEx(h, offset, nullptr, FILE_BEGIN);
+                }
+                DWORD done = 0;
+                if (!WriteFile(h, buffer, length, &done, nullptr) || done != length) {
+                    LogFailure(L"WriteFile", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                    break;
+                }
+                written += done;
+            }
+            double seconds = CounterToSeconds(QueryCounter() - start);
+
+            wchar_t result[96];
+            if (random)
+                swprintf_s(result, L"%.0f IOPS", (written / length) / seconds);
+            else
+                swprintf_s(result, L"%.1f MB/s", (double)written / 1e6 / seconds);
+            std::wcout << L"[BENCH] " << label << (random ? L" RandomWrite Block=" + FormatSize(randomBlock)
+                                                          : L" SequentialWrite Block=" + FormatSize(blockSize))
+                       << L": " << result << std::endl;
+
+            CloseHandle(h);
+            DeleteFileW(path.c_str());
+        }
+    }
+    VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+// nNumberOfLinks from BY_HANDLE_FILE_INFORMATION, or 0 if it cannot be read.
+DWORD GetLinkCount(const std::wstring& path) {
+    HANDLE h = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return 0;
+    BY_HANDLE_FILE_INFORMATION info;
+    DWORD links = GetFileInformationByHandle(h, &info) ? info.nNumberOfLinks : 0;
+    CloseHandle(h);
+    return links;
+}
+
+// Counts the names of a file with FindFirstFileNameW/FindNextFileNameW.
+ULONGLONG CountFileNames(const std::wstring& path) {
+    std::vector<wchar_t> name(MAX_PATH);
+    DWORD length = (DWORD)name.size();
+    HANDLE hFind = FindFirstFileNameW(path.c_str(), 0, &length, name.data());
+    if (hFind == INVALID_HANDLE_VALUE)
+        return 0;
+    ULONGLONG names = 1;
+    for (;;) {
+        length = (DWORD)name.size();
+        if (FindNextFileNameW(hFind, &length, name.data())) {
+            ++names;
+        } else if (GetLastError() == ERROR_MORE_DATA) {
+            name.resize(length);
+        } else {
+            break;
+        }
+    }
+    FindClose(hFind);
+    return names;
+}
+
+// Fans `files` files out to `links` hard links each (1023 is the NTFS limit),
+// reporting CreateHardLinkW latency per band of existing link count, the cost
+// of enumerating all names with FindFirstFileNameW/FindNextFileNameW, and
+// DeleteFileW latency as the links are removed again. nNumberOfLinks is
+// checked against the expected count at every band boundary.
+void BenchmarkHardLinks(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG files = GetBenchmarkCount(options, L"files", 10);
+    ULONGLONG links = std::min<ULONGLONG>(GetBenchmarkCount(options, L"links", 1023), 1023);
+    ULONGLONG band = std::max<ULONGLONG>(1, GetBenchmarkCount(options, L"band", 128));
+    size_t bands = (size_t)((links + band - 1) / band);
+
+    std::vector<LatencyHistogram> createLatency(bands), deleteLatency(bands);
+    LatencyHistogram enumerateLatency;
+    ULONGLONG mismatches = 0, enumerated = 0;
+
+    for (ULONGLONG f = 0; f < files; ++f) {
+        std::wstring fileDir = dir + L"\\f" + std::to_wstring(f);
+        std::wstring target = fileDir + L"\\target.bin";
+        CreateDirectoryW(fileDir.c_str(), nullptr);
+        WriteDummyContent(target);
+
+        ULONGLONG created = 0;
+        for (; created < links; ++created) {
+            std::wstring link = fileDir + L"\\link" + std::to_wstring(created);
+            LONGLONG start = QueryCounter();
+            BOOL ok = CreateHardLinkW(link.c_str(), target.c_str(), nullptr);
+            RecordLatency(createLatency[(size_t)(created / band)], CounterToNanoseconds(QueryCounter() - start));
+            if (!ok) {
+                LogFailure(L"CreateHardLinkW", L"Link " + std::to_wstring(created + 1) + L" of " + target +
+                                               L" failed. Error: " + std::to_wstring(GetLastError()));
+                break;
+            }
+            if ((created + 1) % band == 0 && GetLinkCount(target) != created + 2)
+                mismatches++;
+        }
+        if (GetLinkCount(target) != created + 1)
+            mismatches++;
+
+        LONGLONG start = QueryCounter();
+        ULONGLONG names = CountFileNames(target);
+        RecordLatency(enumerateLatency, CounterToNanoseconds(QueryCounter() - start));
+        enumerated += names;
+        if (names != created + 1)
+            LogFailure(L"FindFirstFileNameW", target + L" listed " + std::to_wstring(names) + L" names, expected " +
+                                              std::to_wstring(created + 1));
+
+        for (ULONGLONG remaining = created; remaining > 0; --remaining) {
+            std::wstring link = fileDir + L"\\link" + std::to_wstring(remaining - 1);
+            start = QueryCounter();
+            BOOL ok = DeleteFileW(link.c_str());
+            RecordLatency(deleteLatency[(size_t)((remaining - 1) / band)], CounterToNanoseconds(QueryCounter() - start));
+            if (!ok)
+                LogFailure(L"DeleteFileW", link + L" failed. Error: " + std::to_wstring(GetLastError()));
+            if ((remaining - 1) % band == 0 && GetLinkCount(target) != remaining)
+                mismatches++;
+        }
+    }
+
+    for (size_t b = 0; b < bands; ++b) {
+        std::wstring range = L" Links=" + std::to_wstring(b * band) + L"-" +
+                             std::to_wstring(std::min<ULONGLONG>((b + 1) * band, links) - 1);
+        PrintLatency(L"CreateHardLinkW" + range, createLatency[b]);
+    }
+    PrintLatency(L"FindFirstFileNameW/FindNextFileNameW per file", enumerateLatency);
+    if (enumerateLatency.total != 0) {
+        wchar_t buffer[64];
+        swprintf_s(buffer, L"%.1f names per file", (double)enumerated / enumerateLatency.total);
+        std::wcout << L"[BENCH] FindFirstFileNameW/FindNextFileNameW: " << buffer << std::endl;
+    }
+    for (size_t b = 0; b < bands; ++b) {
+        std::wstring range = L" Links=" + std::to_wstring(b * band) + L"-" +
+                             std::to_wstring(std::min<ULONGLONG>((b + 1) * band, links) - 1);
+        PrintLatency(L"DeleteFileW" + range, deleteLatency[b]);
+    }
+
+    if (mismatches == 0)
+        LogSuccess(L"GetFileInformationByHandle", L"nNumberOfLinks matched the expected link count at every check");
+    else
+        LogFailure(L"GetFileInformationByHandle", L"nNumberOfLinks disagreed with the expected link count " +
+                                                  std::to_wstring(mismatches) + L" times");
+}
+
+// Times `iterations` open/close cycles of `path` into `latency`. Returns
+// ERROR_SUCCESS or the error of the first failed open.
+DWORD TimeOpens(const std::wstring& path, DWORD flags, ULONGLONG iterations, LatencyHistogram& latency) {
+    for (ULONGLONG i = 0; i < iterations; ++i) {
+        LONGLONG start = QueryCounter();
+        HANDLE h = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, flags, nullptr);
+        if (h == INVALID_HANDLE_VALUE)
+            return GetLastError();
+        CloseHandle(h);
+        RecordLatency(latency, CounterToNanoseconds(QueryCounter() - start));
+    }
+    return ERROR_SUCCESS;
+}
+
+// Builds a chain of file symbolic links, each pointing at the previous one,
+// and times opens through every depth against opening the target directly
+// and opening the outermost link itself with FILE_FLAG_OPEN_REPARSE_POINT.
+// The first depth that fails to resolve is reported with its error. A second
+// sweep opens a file through a path that crosses 1..N directory symlinks.
+void BenchmarkSymlinkChains(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG iterations = GetBenchmarkCount(options, L"iterations", 1000);
+    DWORD maxDepth = (DWORD)GetBenchmarkCount(options, L"max-depth", 40);
+    DWORD maxHops = (DWORD)GetBenchmarkCount(options, L"max-hops", 31);
+
+    std::wstring target = dir + L"\\ChainTarget.txt";
+    WriteDummyContent(target);
+    LatencyHistogram direct;
+    TimeOpens(target, 0, iterations, direct);
+    PrintLatency(L"CreateFileW Direct", direct);
+
+    std::wstring previous = target;
+    bool failed = false;
+    for (DWORD depth = 1; depth <= maxDepth && !failed; ++depth) {
+        std::wstring link = dir + L"\\Chain" + std::to_wstring(depth) + L".lnk";
+        if (!CreateSymbolicLinkW(link.c_str(), previous.c_str(), 0)) {
+            LogFailure(L"CreateSymbolicLinkW", L"Failed to create chain link " + std::to_wstring(depth) +
+                                               L". Error: " + std::to_wstring(GetLastError()));
+            return;
+        }
+        previous = link;
+
+        LatencyHistogram followed, reparsePoint;
+        DWORD error = TimeOpens(link, 0, iterations, followed);
+        TimeOpens(link, FILE_FLAG_OPEN_REPARSE_POINT, iterations, reparsePoint);
+        if (error != ERROR_SUCCESS) {
+            std::wcout << L"[BENCH] Symlink chain stopped resolving at depth " << depth << L". Error: " << error
+                       << std::endl;
+            failed = true;
+            continue;
+        }
+        PrintLatency(L"CreateFileW Chain Depth=" + std::to_wstring(depth), followed);
+        PrintLatency(L"CreateFileW FILE_FLAG_OPEN_REPARSE_POINT Depth=" + std::to_wstring(depth), reparsePoint);
+    }
+    if (!failed)
+        std::wcout << L"[BENCH] Symlink chain resolved up to depth " << maxDepth << std::endl;
+
+    // Directory hops: Hops\h1\h2\...\hN\leaf.txt where every hK is a directory
+    // symlink to a real directory RK.
+    std::wstring hops = dir + L"\\Hops";
+    CreateDirectoryW(hops.c_str(), nullptr);
+    std::wstring path = hops;
+    for (DWORD hop = 1; hop <= maxHops; ++hop) {
+        std::wstring real = hops + L"\\R" + std::to_wstring(hop);
+        std::wstring link = path + L"\\h" + std::to_wstring(hop);
+        CreateDirectoryW(real.c_str(), nullptr);
+        if (!CreateSymbolicLinkW(link.c_str(), real.c_str(), SYMBOLIC_LINK_FLAG_DIRECTORY)) {
+            LogFailure(L"CreateSymbolicLinkW", L"Failed to create directory hop " + std::to_wstring(hop) +
+                                               L". Error: " + std::to_wstring(GetLastError()));
+            return;
+        }
+        path = link;
+        WriteDummyContent(real + L"\\leaf.txt");
+
+        LatencyHistogram latency;
+        DWORD error = TimeOpens(path + L"\\leaf.txt", 0, iterations, latency);
+        if (error != ERROR_SUCCESS) {
+            std::wcout << L"[BENCH] Directory symlink hops stopped resolving at " << hop << L" hops. Error: " << error
+                       << std::endl;
+            break;
+        }
+        PrintLatency(L"CreateFileW DirectoryHops=" + std::to_wstring(hop), latency);
+    }
+}
+
+enum AttributeMethod { ATTRIBUTE_BY_PATH, ATTRIBUTE_OPEN_PER_UPDATE, ATTRIBUTE_HELD_HANDLE };
+
+struct AttributeWorker {
+    std::vector<std::wstring> paths;
+    std::vector<HANDLE> handles;
+    ULONGLONG updates;
+    AttributeMethod method;
+    bool timestamps;
+    LatencyHistogram latency;
+    ULONGLONG errors = 0;
+    DWORD lastError = ERROR_SUCCESS;
+};
+
+// Applies one attribute or timestamp update. The path-based route for
+// timestamps is CreateFileW plus SetFileTime, since there is no path-only API.
+bool UpdateAttributes(AttributeWorker& worker, size_t file, ULONGLONG i) {
+    FILE_BASIC_INFO info = {};
+    FILETIME now = {};
+    if (worker.timestamps) {
+        GetSystemTimeAsFileTime(&now);
+        info.LastWriteTime.QuadPart = (LONGLONG)(((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime);
+    } else {
+        info.FileAttributes = (i & 1) ? FILE_ATTRIBUTE_ARCHIVE : FILE_ATTRIBUTE_NORMAL;
+    }
+
+    if (worker.method == ATTRIBUTE_HELD_HANDLE)
+        return SetFileInformationByHandle(worker.handles[file], FileBasicInfo, &info, sizeof(info)) != FALSE;
+    if (worker.method == ATTRIBUTE_BY_PATH && !worker.timestamps)
+        return SetFileAttributesW(worker.paths[file].c_str(), info.FileAttributes) != FALSE;
+
+    HANDLE h = CreateFileW(worker.paths[file].c_str(), FILE_WRITE_ATTRIBUTES,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = worker.method == ATTRIBUTE_BY_PATH
+                  ? SetFileTime(h, nullptr, nullptr, &now) != FALSE
+                  : SetFileInformationByHandle(h, FileBasicInfo, &info, sizeof(info)) != FALSE;
+    DWORD error = GetLastError();
+    CloseHandle(h);
+    SetLastError(error);
+    return ok;
+}
+
+static DWORD WINAPI AttributeThread(LPVOID param) {
+    AttributeWorker& worker = *static_cast<AttributeWorker*>(param);
+    worker.latency = LatencyHistogram();
+    for (ULONGLONG i = 0; i < worker.updates; ++i) {
+        LONGLONG start = QueryCounter();
+        bool ok = UpdateAttributes(worker, (size_t)(i % worker.paths.size()), i / worker.paths.size());
+        RecordLatency(worker.latency, CounterToNanoseconds(QueryCounter() - start));
+        if (!ok) {
+            worker.errors++;
+            worker.lastError = GetLastError();
+        }
+    }
+    return 0;
+}
+
+// Compares attribute and timestamp update rates through SetFileAttributesW
+// (or CreateFileW plus SetFileTime for timestamps), through a fresh handle
+// and SetFileInformationByHandle(FileBasicInfo) per update, and through
+// SetFileInformationByHandle on handles held open for the whole run. Each
+// thread updates its own set of files round-robin.
+void BenchmarkAttributes(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG files = GetBenchmarkCount(options, L"files", 100);
+    ULONGLONG updates = GetBenchmarkCount(options, L"updates", 20000);
+    std::vector<ULONGLONG> threadCounts = GetBenchmarkSizeList(options, L"threads", { 1, 4, 16 });
+    if (files == 0)
+        files = 1;
+
+    struct { AttributeMethod method; const wchar_t* name; } methods[] = {
+        { ATTRIBUTE_BY_PATH, L"Path" },
+        { ATTRIBUTE_OPEN_PER_UPDATE, L"CreateFileW+SetFileInformationByHandle" },
+        { ATTRIBUTE_HELD_HANDLE, L"SetFileInformationByHandle" },
+    };
+
+    for (ULONGLONG threadCount : threadCounts) {
+        if (threadCount == 0)
+            continue;
+        std::vector<AttributeWorker> workers((size_t)threadCount);
+        std::vector<LPVOID> params;
+        bool ready = true;
+        for (size_t t = 0; t < workers.size() && ready; ++t) {
+            for (ULONGLONG i = 0; i < files; ++i) {
+                std::wstring path = dir + L"\\a" + std::to_wstring(t) + L"-" + std::to_wstring(i) + L".txt";
+                HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE | FILE_WRITE_ATTRIBUTES,
+                                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS,
+                                       FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (h == INVALID_HANDLE_VALUE) {
+                    LogFailure(L"CreateFileW", L"Failed to create " + path + L". Error: " +
+                                               std::to_wstring(GetLastError()));
+                    ready = false;
+                    break;
+                }
+                workers[t].paths.push_back(path);
+                workers[t].handles.push_back(h);
+            }
+            workers[t].updates = updates;
+            params.push_back(&workers[t]);
+        }
+
+        for (int timestamps = 0; timestamps < 2 && ready; ++timestamps) {
+            for (const auto& method : methods) {
+                for (auto& worker : workers) {
+                    worker.method = method.method;
+                    worker.timestamps = timestamps != 0;
+                    worker.errors = 0;
+                }
+                double seconds = RunConcurrently(AttributeThread, params);
+
+                LatencyHistogram latency;
+                ULONGLONG errors = 0;
+                DWORD lastError = ERROR_SUCCESS;
+                for (const auto& worker : workers) {
+                    MergeLatency(latency, worker.latency);
+                    errors += worker.errors;
+                    if (worker.errors != 0)
+                        lastError = worker.lastError;
+                }
+
+                std::wstring name = method.method == ATTRIBUTE_BY_PATH
+                                        ? (timestamps ? L"CreateFileW+SetFileTime" : L"SetFileAttributesW")
+                                        : method.name;
+                std::wstring label = name + (timestamps ? L" Timestamps" : L" Attributes") + L" Threads=" +
+                                     std::to_wstring(threadCount);
+                wchar_t buffer[64];
+                swprintf_s(buffer, L"%.0f updates/s", (double)latency.total / seconds);
+                std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+                PrintLatency(label, latency);
+                if (errors != 0)
+                    LogFailure(name, label + L" " + std::to_wstring(errors) + L" updates failed. Error: " +
+                                     std::to_wstring(lastError));
+            }
+        }
+
+        for (auto& worker : workers) {
+            for (HANDLE h : worker.handles)
+                CloseHandle(h);
+            for (const auto& path : worker.paths)
+                DeleteFileW(path.c_str());
+        }
+    }
+}
+
+// FILE_DISPOSITION_INFO_EX (Windows 10 1607) and its flags. Declared here
+// because older SDKs and mingw-w64 lack them.
+struct DispositionInfoEx {
+    DWORD Flags;
+};
+const DWORD DISPOSITION_FLAG_DELETE = 0x00000001;
+const DWORD DISPOSITION_FLAG_POSIX_SEMANTICS = 0x00000002;
+
+enum DeleteMethod { DELETE_BY_PATH, DELETE_BY_DISPOSITION, DELETE_BY_POSIX_DISPOSITION, DELETE_BY_CLOSE };
+
+// Deletes `path` with the given method. Handle-based methods open with
+// FILE_SHARE_DELETE so they also work while other handles are open.
+bool DeleteByMethod(const std::wstring& path, DeleteMethod method) {
+    if (method == DELETE_BY_PATH)
+        return DeleteFileW(path.c_str()) != FALSE;
+
+    HANDLE h = CreateFileW(path.c_str(), DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, method == DELETE_BY_CLOSE ? FILE_FLAG_DELETE_ON_CLOSE : 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = true;
+    if (method == DELETE_BY_DISPOSITION) {
+        FILE_DISPOSITION_INFO info = {};
+        info.DeleteFile = TRUE;
+        ok = SetFileInformationByHandle(h, FileDispositionInfo, &info, sizeof(info)) != FALSE;
+    } else if (method == DELETE_BY_POSIX_DISPOSITION) {
+        DispositionInfoEx info = { DISPOSITION_FLAG_DELETE | DISPOSITION_FLAG_POSIX_SEMANTICS };
+        ok = SetFileInformationByHandle(h, FileDispositionInfoEx, &info, sizeof(info)) != FALSE;
+    }
+    DWORD error = GetLastError();
+    CloseHandle(h);
+    SetLastError(error);
+    return ok;
+}
+
+// Deletes batches of files with DeleteFileW, FileDispositionInfo,
+// FileDispositionInfoEx with POSIX semantics and FILE_FLAG_DELETE_ON_CLOSE.
+// A second pass keeps another handle open across each delete to show how
+// long the name lingers: whether it is still visible right after the delete
+// and how long it takes to vanish once that last handle is closed.
+void BenchmarkDelete(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG files = GetBenchmarkCount(options, L"files", 10000);
+    ULONGLONG lingerFiles = GetBenchmarkCount(options, L"linger-files", 200);
+    DWORD threads = (DWORD)GetBenchmarkCount(options, L"populate-threads", 8);
+
+    struct { DeleteMethod method; const wchar_t* name; } methods[] = {
+        { DELETE_BY_PATH, L"DeleteFileW" },
+        { DELETE_BY_DISPOSITION, L"FileDispositionInfo" },
+        { DELETE_BY_POSIX_DISPOSITION, L"FileDispositionInfoEx POSIX" },
+        { DELETE_BY_CLOSE, L"FILE_FLAG_DELETE_ON_CLOSE" },
+    };
+
+    for (const auto& method : methods) {
+        std::wstring batch = dir + L"\\" + std::to_wstring(method.method);
+        CreateDirectoryW(batch.c_str(), nullptr);
+        ULONGLONG failed = PopulateDirectory(batch, 0, files, threads);
+        if (failed != 0) {
+            LogFailure(L"CreateFileW", L"Failed to create " + std::to_wstring(failed) + L" files for " + method.name);
+            return;
+        }
+
+        LatencyHistogram latency;
+        ULONGLONG errors = 0;
+        DWORD lastError = ERROR_SUCCESS;
+        LONGLONG begin = QueryCounter();
+        for (ULONGLONG i = 0; i < files; ++i) {
+            std::wstring path = batch + L"\\e" + std::to_wstring(i) + L".txt";
+            LONGLONG start = QueryCounter();
+            bool ok = DeleteByMethod(path, method.method);
+            RecordLatency(latency, CounterToNanoseconds(QueryCounter() - start));
+            if (!ok) {
+                errors++;
+                lastError = GetLastError();
+            }
+        }
+        double seconds = CounterToSeconds(QueryCounter() - begin);
+
+        wchar_t buffer[64];
+        swprintf_s(buffer, L"%.0f deletes/s", (double)(files - errors) / seconds);
+        std::wcout << L"[BENCH] " << method.name << L": " << buffer << std::endl;
+        PrintLatency(method.name, latency);
+        if (errors != 0)
+            LogFailure(method.name, std::to_wstring(errors) + L" deletes failed. Error: " + std::to_wstring(lastError));
+
+        // Linger pass: a reader handle stays open across the delete.
+        LatencyHistogram linger;
+        ULONGLONG pending = 0;
+        ULONGLONG lingerErrors = 0;
+        for (ULONGLONG i = 0; i < lingerFiles; ++i) {
+            std::wstring path = batch + L"\\l" + std::to_wstring(i) + L".txt";
+            WriteDummyContent(path);
+            HANDLE holder = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (holder == INVALID_HANDLE_VALUE || !DeleteByMethod(path, method.method)) {
+                lingerErrors++;
+                lastError = GetLastError();
+                if (holder != INVALID_HANDLE_VALUE)
+                    CloseHandle(holder);
+                DeleteFileW(path.c_str());
+                continue;
+            }
+            if (FileIsVisible(path))
+                pending++;
+
+            // Poll with SwitchToThread for the first millisecond, then at most
+            // once per Sleep(1) tick: on a share every poll is an open on the
+            // server, and a tight loop would load the very server whose
+            // linger time is being measured.
+            LONGLONG start = QueryCounter();
+            CloseHandle(holder);
+            for (;;) {
+                bool visible = FileIsVisible(path);
+                double elapsedMsec = CounterToSeconds(QueryCounter() - start) * 1000.0;
+                if (!visible || elapsedMsec >= g_settleTimeoutMsec)
+                    break;
+                if (elapsedMsec < 1.0)
+                    SwitchToThread();
+                else
+                    Sleep(1);
+            }
+            RecordLatency(linger, CounterToNanoseconds(QueryCounter() - start));
+        }
+
+        std::wstring label = std::wstring(method.name) + L" Linger";
+        std::wcout << L"[BENCH] " << label << L": " << pending << L"/" << (lingerFiles - lingerErrors)
+                   << L" names still visible while another handle was open" << std::endl;
+        PrintLatency(label + L" (last close to name gone)", linger);
+        if (lingerErrors != 0)
+            LogFailure(method.name, label + L" " + std::to_wstring(lingerErrors) + L" deletes failed. Error: " +
+                                    std::to_wstring(lastError));
+    }
+}
+
+// Fills `block` with English text in which `percent` of the bytes are
+// replaced by random ones: 0 compresses extremely well, 100 not at all.
+void FillWithEntropy(std::vector<BYTE>& block, ULONGLONG percent, std::mt19937& generator) {
+    const char* text = "The quick brown fox jumps over the lazy dog. ";
+    for (size_t i = 0; i < block.size(); ++i)
+        block[i] = generator() % 100 < percent ? (BYTE)generator() : (BYTE)text[i % 45];
+}
+
+enum SpaceLayout { SPACE_DENSE, SPACE_COMPRESSED, SPACE_SPARSE };
+
+// Writes a new file `size` bytes long from `block`. Compressed files get
+// FSCTL_SET_COMPRESSION before the first write. Sparse files get
+// FSCTL_SET_SPARSE and only one block per `stride` bytes is written, the
+// rest is left as holes. Returns the bytes handed to WriteFile, or 0 on
+// failure.
+ULONGLONG WriteSpaceFile(const std::wstring& path, ULONGLONG size, const std::vector<BYTE>& block, SpaceLayout layout,
+                         ULONGLONG stride) {
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return 0;
+
+    DWORD returned = 0;
+    bool ok = true;
+    if (layout == SPACE_COMPRESSED) {
+        USHORT format = COMPRESSION_FORMAT_DEFAULT;
+        ok = DeviceIoControl(h, FSCTL_SET_COMPRESSION, &format, sizeof(format), nullptr, 0, &returned, nullptr) != FALSE;
+    } else if (layout == SPACE_SPARSE) {
+        ok = DeviceIoControl(h, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr) != FALSE;
+    }
+
+    ULONGLONG logical = 0;
+    ULONGLONG step = layout == SPACE_SPARSE ? std::max<ULONGLONG>(stride, block.size()) : block.size();
+    for (ULONGLONG offset = 0; ok && offset < size; offset += step) {
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)offset;
+        DWORD chunk = (DWORD)std::min<ULONGLONG>(block.size(), size - offset);
+        DWORD written = 0;
+        ok = SetFilePointerEx(h, position, nullptr, FILE_BEGIN) &&
+             WriteFile(h, block.data(), chunk, &written, nullptr) && written == chunk;
+        logical += written;
+    }
+    if (ok && layout == SPACE_SPARSE) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        ok = SetFilePointerEx(h, end, nullptr, FILE_BEGIN) && SetEndOfFile(h);
+    }
+    if (ok)
+        ok = FlushFileBuffers(h) != FALSE;
+    DWORD error = GetLastError();
+    CloseHandle(h);
+    SetLastError(error);
+    return ok ? logical : 0;
+}
+
+// Bytes a file occupies on disk: GetCompressedFileSizeW accounts for both
+// compression and sparse holes.
+ULONGLONG GetFileAllocation(const std::wstring& path) {
+    DWORD high = 0;
+    DWORD low = GetCompressedFileSizeW(path.c_str(), &high);
+    if (low == INVALID_FILE_SIZE && GetLastError() != ERROR_SUCCESS)
+        return 0;
+    return ((ULONGLONG)high << 32) | low;
+}
+
+// Reports allocation against bytes logically written for one workload phase,
+// both as the sum of per-file allocation and as the drop in the volume's
+// free space, which also charges metadata such as MFT records and indexes.
+void PrintSpaceUsage(const std::wstring& label, ULONGLONG logical, ULONGLONG allocated, const VolumeSpace& before,
+                     const VolumeSpace& after) {
+    double drop = (double)before.freeBytes - (double)after.freeBytes;
+    double divisor = logical != 0 ? (double)logical : 1.0;
+    wchar_t buffer[224];
+    swprintf_s(buffer, L"logical %.2f MiB, file allocation %.2f MiB (%.2fx), volume free space drop %.2f MiB (%.2fx)",
+               logical / 1048576.0, allocated / 1048576.0, allocated / divisor, drop / 1048576.0, drop / divisor);
+    std::wcout << L"[BENCH] " << label << L": " << buffer << std::endl;
+}
+
+// Runs small-file, large dense, NTFS-compressed and sparse write phases and
+// reports each phase's write amplification on the volume of the target
+// root. The free space drop is only meaningful while nothing else writes to
+// that volume.
+void BenchmarkSpace(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG smallFiles = GetBenchmarkCount(options, L"small-files", 1000);
+    ULONGLONG smallSize = GetBenchmarkSize(options, L"small-size", 100);
+    ULONGLONG largeSize = GetBenchmarkSize(options, L"large-size", 64ULL << 20);
+    ULONGLONG stride = GetBenchmarkSize(options, L"sparse-stride", 1ULL << 20);
+
+    VolumeSpace volume;
+    if (!QueryVolumeSpace(dir, volume)) {
+        LogFailure(L"GetDiskFreeSpaceExW", L"Failed to query the volume of " + dir + L". Error: " +
+                                           std::to_wstring(GetLastError()));
+        return;
+    }
+    std::wcout << L"[BENCH] Volume " << volume.root << L": cluster " << FormatSize(volume.clusterSize) << L", free "
+               << (volume.freeBytes >> 20) << L" MiB of " << (volume.totalBytes >> 20) << L" MiB" << std::endl;
+
+    std::vector<BYTE> random(1 << 20), text(1 << 20);
+    std::mt19937 generator(12345);
+    FillWithEntropy(random, 100, generator);
+    FillWithEntropy(text, 0, generator);
+
+    struct {
+        const wchar_t* name;
+        SpaceLayout layout;
+        ULONGLONG files;
+        ULONGLONG size;
+        const std::vector<BYTE>* data;
+    } phases[] = {
+        { L"SmallFiles", SPACE_DENSE, smallFiles, smallSize, &random },
+        { L"LargeFile", SPACE_DENSE, 1, largeSize, &random },
+        { L"Compressed", SPACE_COMPRESSED, 1, largeSize, &text },
+        { L"Sparse", SPACE_SPARSE, 1, largeSize, &random },
+    };
+
+    for (const auto& phase : phases) {
+        std::wstring phaseDir = dir + L"\\" + phase.name;
+        CreateDirectoryW(phaseDir.c_str(), nullptr);
+        std::vector<BYTE> block(phase.data->begin(), phase.data->begin() +
+                                                     (size_t)std::min<ULONGLONG>(phase.data->size(), phase.size));
+
+        VolumeSpace before, after;
+        if (!QueryVolumeSpace(dir, before)) {
+            LogFailure(L"GetDiskFreeSpaceExW", std::wstring(phase.name) + L" query before the phase failed. Error: " +
+                                               std::to_wstring(GetLastError()));
+            RemoveDirectoryTree(phaseDir);
+            continue;
+        }
+        ULONGLONG logical = 0, allocated = 0;
+        DWORD error = ERROR_SUCCESS;
+        for (ULONGLONG i = 0; error == ERROR_SUCCESS && i < phase.files; ++i) {
+            std::wstring path = phaseDir + L"\\s" + std::to_wstring(i) + L".bin";
+            ULONGLONG written = WriteSpaceFile(path, phase.size, block, phase.layout, stride);
+            if (written == 0) {
+                error = GetLastError();
+                break;
+            }
+            logical += written;
+            allocated += GetFileAllocation(path);
+        }
+
+        if (error != ERROR_SUCCESS)
+            LogFailure(phase.name, L"Write phase failed. Error: " + std::to_wstring(error));
+        else if (!QueryVolumeSpace(dir, after))
+            LogFailure(L"GetDiskFreeSpaceExW", std::wstring(phase.name) + L" query after the phase failed. Error: " +
+                                               std::to_wstring(GetLastError()));
+        else
+            PrintSpaceUsage(phase.name, logical, allocated, before, after);
+        RemoveDirectoryTree(phaseDir);
+    }
+}
+
+// Writes one file per entropy level with and without FSCTL_SET_COMPRESSION
+// and reads it back with FILE_FLAG_NO_BUFFERING, so the read pass pays for
+// decompression instead of hitting the cache. The on-disk ratio comes from
+// GetCompressedFileSizeW against the logical size.
+void BenchmarkCompression(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG fileSize = GetBenchmarkSize(options, L"file-size", 256ULL << 20);
+    ULONGLONG blockSize = GetBenchmarkSize(options, L"block-size", 1 << 20);
+    std::vector<ULONGLONG> entropyLevels = GetBenchmarkSizeList(options, L"entropy", { 0, 25, 50, 75, 100 });
+    DWORD sectorSize = GetUnbufferedAlignment(dir);
+    if (blockSize == 0 || blockSize % sectorSize != 0 || blockSize > MAXDWORD) {
+        LogFailure(L"BenchmarkCompression", L"--block-size must be a multiple of the " + FormatSize(sectorSize) +
+                                            L" sector size for FILE_FLAG_NO_BUFFERING reads");
+        return;
+    }
+
+    BYTE* buffer = (BYTE*)VirtualAlloc(nullptr, (SIZE_T)blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (buffer == nullptr) {
+        LogFailure(L"VirtualAlloc", L"Read buffer allocation failed");
+        return;
+    }
+    std::vector<BYTE> block((size_t)blockSize);
+    std::mt19937 generator(12345);
+    std::wstring path = dir + L"\\Compression.bin";
+
+    for (ULONGLONG entropy : entropyLevels) {
+        FillWithEntropy(block, entropy, generator);
+        for (int compressed = 0; compressed < 2; ++compressed) {
+            std::wstring label = std::wstring(compressed ? L"Compressed" : L"Uncompressed") + L" Entropy=" +
+                                 std::to_wstring(entropy) + L"%";
+
+            double cpuStart = ProcessCpuSeconds();
+            LONGLONG start = QueryCounter();
+            ULONGLONG written = WriteSpaceFile(path, fileSize, block, compressed ? SPACE_COMPRESSED : SPACE_DENSE, 0);
+            if (written == 0) {
+                LogFailure(L"WriteFile", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                DeleteFileW(path.c_str());
+                continue;
+            }
+            PrintThroughput(L"WriteFile " + label, written, CounterToSeconds(QueryCounter() - start),
+                            ProcessCpuSeconds() - cpuStart);
+
+            ULONGLONG allocated = GetFileAllocation(path);
+            wchar_t ratio[96];
+            swprintf_s(ratio, L"on disk %.2f MiB of %.2f MiB, ratio %.2f", allocated / 1048576.0,
+                       written / 1048576.0, (double)allocated / written);
+            std::wcout << L"[BENCH] GetCompressedFileSizeW " << label << L": " << ratio << std::endl;
+
+            HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+            if (h == INVALID_HANDLE_VALUE) {
+                LogFailure(L"CreateFileW", label + L" read open failed. Error: " + std::to_wstring(GetLastError()));
+            } else {
+                cpuStart = ProcessCpuSeconds();
+                start = QueryCounter();
+                ULONGLONG moved = 0;
+                for (;;) {
+                    DWORD read = 0;
+                    if (!ReadFile(h, buffer, (DWORD)blockSize, &read, nullptr)) {
+                        LogFailure(L"ReadFile", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                        break;
+                    }
+                    if (read == 0)
+                        break;
+                    moved += read;
+                }
+                CloseHandle(h);
+                PrintThroughput(L"ReadFile " + label, moved, CounterToSeconds(QueryCounter() - start),
+                                ProcessCpuSeconds() - cpuStart);
+            }
+            DeleteFileW(path.c_str());
+        }
+    }
+    VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+// Writes `length` bytes from `block` at `offset`, repeating the block as
+// needed.
+bool WriteAt(HANDLE h, ULONGLONG offset, ULONGLONG length, const std::vector<BYTE>& block) {
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)offset;
+    if (!SetFilePointerEx(h, position, nullptr, FILE_BEGIN))
+        return false;
+    for (ULONGLONG done = 0; done < length;) {
+        DWORD chunk = (DWORD)std::min<ULONGLONG>(block.size(), length - done);
+        DWORD written = 0;
+        if (!WriteFile(h, block.data(), chunk, &written, nullptr) || written != chunk)
+            return false;
+        done += written;
+    }
+    return true;
+}
+
+// Enumerates every allocated range of `h` with FSCTL_QUERY_ALLOCATED_RANGES,
+// `batch` ranges per call. Returns the number of ranges, or -1 on failure.
+LONGLONG CountAllocatedRanges(HANDLE h, ULONGLONG fileSize, DWORD batch, ULONGLONG& calls) {
+    std::vector<FILE_ALLOCATED_RANGE_BUFFER> ranges(batch);
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    query.FileOffset.QuadPart = 0;
+    query.Length.QuadPart = (LONGLONG)fileSize;
+    LONGLONG count = 0;
+    calls = 0;
+    for (;;) {
+        DWORD returned = 0;
+        BOOL ok = DeviceIoControl(h, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), ranges.data(),
+                                  (DWORD)(ranges.size() * sizeof(ranges[0])), &returned, nullptr);
+        calls++;
+        if (!ok && GetLastError() != ERROR_MORE_DATA)
+            return -1;
+        DWORD found = returned / sizeof(ranges[0]);
+        count += found;
+        if (ok || found == 0)
+            return count;
+        const FILE_ALLOCATED_RANGE_BUFFER& last = ranges[found - 1];
+        LONGLONG next = last.FileOffset.QuadPart + last.Length.QuadPart;
+        query.Length.QuadPart = (LONGLONG)fileSize - next;
+        query.FileOffset.QuadPart = next;
+    }
+}
+
+// Reads `length` bytes at `offset` uncached and returns the bytes read.
+ULONGLONG ReadRange(HANDLE h, ULONGLONG offset, ULONGLONG length, BYTE* buffer, DWORD blockSize) {
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)offset;
+    if (!SetFilePointerEx(h, position, nullptr, FILE_BEGIN))
+        return 0;
+    ULONGLONG moved = 0;
+    while (moved < length) {
+        DWORD read = 0;
+        if (!ReadFile(h, buffer, blockSize, &read, nullptr) || read == 0)
+            break;
+        moved += read;
+    }
+    return moved;
+}
+
+// Grows a sparse file to each extent count in turn by writing `chunk`-sized
+// data extents separated by equally sized holes. At every step it times the
+// extent writes, a full FSCTL_QUERY_ALLOCATED_RANGES enumeration and
+// FSCTL_SET_ZERO_DATA punching of sampled extents, which are rewritten
+// afterwards. The file starts with a hole and a dense region of --read-size
+// each, read uncached at the end to compare throughput over holes, data and
+// the interleaved extents. Chunks should be a multiple of the 64K sparse
+// allocation unit NTFS uses with 4K clusters, or holes do not materialize.
+void BenchmarkSparse(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG chunk = GetBenchmarkSize(options, L"chunk", 64 << 10);
+    ULONGLONG readSize = GetBenchmarkSize(options, L"read-size", 256ULL << 20);
+    ULONGLONG punches = GetBenchmarkCount(options, L"punches", 1000);
+    DWORD batch = (DWORD)GetBenchmarkCount(options, L"range-batch", 4096);
+    std::vector<ULONGLONG> extentCounts = GetBenchmarkSizeList(options, L"extents", { 1000, 10000, 100000 });
+    DWORD blockSize = 1 << 20;
+    DWORD sectorSize = GetUnbufferedAlignment(dir);
+    if (chunk == 0 || batch == 0) {
+        LogFailure(L"BenchmarkSparse", L"--chunk and --range-batch must be positive");
+        return;
+    }
+    if (readSize % sectorSize != 0 || chunk % sectorSize != 0) {
+        LogFailure(L"BenchmarkSparse", L"--read-size and --chunk must be multiples of the " + FormatSize(sectorSize) +
+                                       L" sector size for FILE_FLAG_NO_BUFFERING reads");
+        return;
+    }
+
+    std::wstring path = dir + L"\\Sparse.bin";
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        LogFailure(L"CreateFileW", L"Failed to create " + path + L". Error: " + std::to_wstring(GetLastError()));
+        return;
+    }
+    DWORD returned = 0;
+    std::vector<BYTE> block(blockSize);
+    std::mt19937 generator(12345);
+    FillWithEntropy(block, 100, generator);
+
+    // Layout: [hole: readSize][data: readSize][data chunk, hole chunk, ...]
+    ULONGLONG extentBase = 2 * readSize;
+    if (!DeviceIoControl(h, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr) ||
+        !WriteAt(h, readSize, readSize, block)) {
+        LogFailure(L"FSCTL_SET_SPARSE", L"Failed to prepare sparse file. Error: " + std::to_wstring(GetLastError()));
+        CloseHandle(h);
+        DeleteFileW(path.c_str());
+        return;
+    }
+
+    ULONGLONG extents = 0;
+    for (ULONGLONG target : extentCounts) {
+        if (target <= extents)
+            continue;
+        std::wstring label = L"Extents=" + std::to_wstring(target);
+
+        ULONGLONG previous = extents;
+        LONGLONG start = QueryCounter();
+        bool ok = true;
+        for (; ok && extents < target; ++extents)
+            ok = WriteAt(h, extentBase + extents * 2 * chunk, chunk, block);
+        ULONGLONG fileSize = extentBase + extents * 2 * chunk;
+        if (!ok) {
+            LogFailure(L"WriteFile", label + L" extent write failed. Error: " + std::to_wstring(GetLastError()));
+            break;
+        }
+        FlushFileBuffers(h);
+        wchar_t buffer[96];
+        swprintf_s(buffer, L"%.0f extents/s", (double)(extents - previous) / CounterToSeconds(QueryCounter() - start));
+        std::wcout << L"[BENCH] WriteFile Sparse " << label << L": " << buffer << std::endl;
+
+        ULONGLONG calls = 0;
+        start = QueryCounter();
+        LONGLONG ranges = CountAllocatedRanges(h, fileSize, batch, calls);
+        double seconds = CounterToSeconds(QueryCounter() - start);
+        if (ranges < 0) {
+            LogFailure(L"FSCTL_QUERY_ALLOCATED_RANGES", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+        } else {
+            swprintf_s(buffer, L"%lld ranges in %llu calls, %.3f ms, %.0f ns/range", ranges, calls, seconds * 1e3,
+                       ranges ? seconds * 1e9 / ranges : 0.0);
+            std::wcout << L"[BENCH] FSCTL_QUERY_ALLOCATED_RANGES " << label << L": " << buffer << std::endl;
+        }
+
+        LatencyHistogram latency;
+        std::vector<ULONGLONG> punched;
+        std::uniform_int_distribution<ULONGLONG> pick(0, extents - 1);
+        for (ULONGLONG i = 0; i < punches; ++i) {
+            ULONGLONG offset = extentBase + pick(generator) * 2 * chunk;
+            FILE_ZERO_DATA_INFORMATION zero;
+            zero.FileOffset.QuadPart = (LONGLONG)offset;
+            zero.BeyondFinalZero.QuadPart = (LONGLONG)(offset + chunk);
+            LONGLONG punchStart = QueryCounter();
+            if (!DeviceIoControl(h, FSCTL_SET_ZERO_DATA, &zero, sizeof(zero), nullptr, 0, &returned, nullptr)) {
+                LogFailure(L"FSCTL_SET_ZERO_DATA", label + L" failed. Error: " + std::to_wstring(GetLastError()));
+                break;
+            }
+            RecordLatency(latency, CounterToNanoseconds(QueryCounter() - punchStart));
+            punched.push_back(offset);
+        }
+        PrintLatency(L"FSCTL_SET_ZERO_DATA " + label, latency);
+        for (ULONGLONG offset : punched)
+            WriteAt(h, offset, chunk, block);
+    }
+    CloseHandle(h);
+
+    BYTE* buffer = (BYTE*)VirtualAlloc(nullptr, blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    h = CreateFileW(path.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING,
+                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+    if (buffer == nullptr || h == INVALID_HANDLE_VALUE) {
+        LogFailure(L"CreateFileW", L"Sparse read open failed. Error: " + std::to_wstring(GetLastError()));
+    } else {
+        struct { const wchar_t* name; ULONGLONG offset; ULONGLONG length; } regions[] = {
+            { L"Holes", 0, readSize },
+            { L"Data", readSize, readSize },
+            { L"Interleaved", extentBase, std::min(readSize, extents * 2 * chunk) },
+        };
+        for (const auto& region : regions) {
+            double cpuStart = ProcessCpuSeconds();
+            LONGLONG start = QueryCounter();
+            ULONGLONG moved = ReadRange(h, region.offset, region.length, buffer, blockSize);
+            PrintThroughput(std::wstring(L"ReadFile Sparse ") + region.name, moved,
+                            CounterToSeconds(QueryCounter() - start), ProcessCpuSeconds() - cpuStart);
+        }
+    }
+    if (h != INVALID_HANDLE_VALUE)
+        CloseHandle(h);
+    if (buffer != nullptr)
+        VirtualFree(buffer, 0, MEM_RELEASE);
+    DeleteFileW(path.c_str());
+}
+
+// A sliding mapped view over a file mapping. Asking for an offset outside
+// the current view unmaps it and maps the `viewSize`-aligned view holding
+// that offset instead.
+struct MappedWindow {
+    HANDLE mapping = nullptr;
+    DWORD access = FILE_MAP_READ;
+    ULONGLONG fileSize = 0;
+    ULONGLONG viewSize = 0;
+    BYTE* view = nullptr;
+    ULONGLONG base = 0;
+    ULONGLONG remaps = 0;
+};
+
+BYTE* MapWindowAt(MappedWindow& window, ULONGLONG offset) {
+    ULONGLONG base = offset - offset % window.viewSize;
+    if (window.view != nullptr && base == window.base)
+        return window.view + (offset - base);
+    if (window.view != nullptr)
+        UnmapViewOfFile(window.view);
+    SIZE_T length = (SIZE_T)std::min(window.viewSize, window.fileSize - base);
+    window.view = (BYTE*)MapViewOfFile(window.mapping, window.access, (DWORD)(base >> 32), (DWORD)base, length);
+    window.base = base;
+    window.remaps++;
+    return window.view != nullptr ? window.view + (offset - base) : nullptr;
+}
+
+// One pass of the mapped I/O benchmark. `viewSize` 0 selects ReadFile and
+// WriteFile instead of a mapped window; `flushEvery` N > 0 calls
+// FlushViewOfFile on the current view after every N updated blocks.
+struct MappedIoPass {
+    bool write;
+    bool random;
+    ULONGLONG viewSize;
+    ULONGLONG flushEvery;
+};
+
+// State of one pass, owned by the benchmark rather than the thread running
+// it, so the file and view can still be released if that thread is ended by
+// an in-page error.
+struct MappedIoRun {
+    const std::wstring* path;
+    ULONGLONG fileSize;
+    DWORD blockSize;
+    ULONGLONG ops;
+    MappedIoPass pass;
+    std::vector<BYTE>* block;
+    std::mt19937_64* generator;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    MappedWindow window;
+    LatencyHistogram latency;
+    DWORD error = ERROR_SUCCESS;
+};
+
+// Reads or updates `ops` blocks of the file, sequentially or at random block
+// offsets, and records the latency of each. Updates end with FlushViewOfFile
+// and FlushFileBuffers so both paths account for getting data to the target.
+// Returns false with run.error set on failure; the caller releases the file.
+bool RunMappedIoPass(MappedIoRun& run) {
+    const MappedIoPass& pass = run.pass;
+    run.file = CreateFileW(run.path->c_str(), GENERIC_READ | (pass.write ? GENERIC_WRITE : 0), 0, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (run.file == INVALID_HANDLE_VALUE) {
+        run.error = GetLastError();
+        return false;
+    }
+    MappedWindow& window = run.window;
+    window.access = pass.write ? FILE_MAP_WRITE : FILE_MAP_READ;
+    window.fileSize = run.fileSize;
+    window.viewSize = pass.viewSize;
+    if (pass.viewSize != 0) {
+        window.mapping =
+            CreateFileMappingW(run.file, nullptr, pass.write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (window.mapping == nullptr) {
+            run.error = GetLastError();
+            return false;
+        }
+    }
+
+    std::vector<BYTE>& block = *run.block;
+    ULONGLONG blocks = run.fileSize / run.blockSize;
+    std::uniform_int_distribution<ULONGLONG> pick(0, blocks - 1);
+    bool ok = true;
+    for (ULONGLONG i = 0; ok && i < run.ops; ++i) {
+        ULONGLONG offset = (pass.random ? pick(*run.generator) : i % blocks) * run.blockSize;
+        LONGLONG start = QueryCounter();
+        if (pass.viewSize != 0) {
+            BYTE* data = MapWindowAt(window, offset);
+            ok = data != nullptr;
+            if (ok && pass.write)
+                std::copy(block.begin(), block.end(), data);
+            else if (ok)
+                std::copy(data, data + run.blockSize, block.begin());
+            if (ok && pass.write && pass.flushEvery != 0 && (i + 1) % pass.flushEvery == 0)
+                ok = FlushViewOfFile(window.view, 0) != FALSE;
+        } else {
+            LARGE_INTEGER position;
+            position.QuadPart = (LONGLONG)offset;
+            DWORD moved = 0;
+            ok = SetFilePointerEx(run.file, position, nullptr, FILE_BEGIN) &&
+                 (pass.write ? WriteFile(run.file, block.data(), run.blockSize, &moved, nullptr)
+                             : ReadFile(run.file, block.data(), run.blockSize, &moved, nullptr)) &&
+                 moved == run.blockSize;
+        }
+        RecordLatency(run.latency, CounterToNanoseconds(QueryCounter() - start));
+    }
+    if (ok && pass.write && window.view != nullptr)
+        ok = FlushViewOfFile(window.view, 0) != FALSE;
+    if (ok && pass.write)
+        ok = FlushFileBuffers(run.file) != FALSE;
+    if (!ok)
+        run.error = GetLastError();
+    return ok;
+}
+
+void CloseMappedIoRun(MappedIoRun& run) {
+    if (run.window.view != nullptr)
+        UnmapViewOfFile(run.window.view);
+    if (run.window.mapping != nullptr)
+        CloseHandle(run.window.mapping);
+    if (run.file != INVALID_HANDLE_VALUE)
+        CloseHandle(run.file);
+}
+
+// Thread running the current pass, and the in-page error that ended it.
+// Touching a mapped view whose page cannot be read, e.g. after a transient
+// SMB failure, raises EXCEPTION_IN_PAGE_ERROR instead of returning an error.
+static DWORD volatile g_mappedIoThreadId = 0;
+static DWORD volatile g_mappedIoFaultStatus = 0;
+static ULONG_PTR volatile g_mappedIoFaultAddress = 0;
+
+// Ends the pass thread on an in-page error. The fault can only come from the
+// copy to or from the view, where the thread holds no locks, and all state it
+// owns lives in MappedIoRun, so the benchmark can release it and report the
+// error as a failed pass. Faults on other threads are left alone.
+static LONG CALLBACK MappedIoFaultHandler(PEXCEPTION_POINTERS info) {
+    if (info->ExceptionRecord->ExceptionCode != EXCEPTION_IN_PAGE_ERROR ||
+        GetCurrentThreadId() != g_mappedIoThreadId || info->ExceptionRecord->NumberParameters < 3)
+        return EXCEPTION_CONTINUE_SEARCH;
+    g_mappedIoFaultAddress = info->ExceptionRecord->ExceptionInformation[1];
+    g_mappedIoFaultStatus = (DWORD)info->ExceptionRecord->ExceptionInformation[2];
+    ExitThread(1);
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static DWORD WINAPI MappedIoThread(LPVOID param) {
+    return RunMappedIoPass(*static_cast<MappedIoRun*>(param)) ? 0 : 2;
+}
+
+// Reads and updates a file sequentially and at random block offsets through
+// buffered ReadFile/WriteFile and through MapViewOfFile windows of each view
+// size. Mapped updates are repeated for each FlushViewOfFile frequency. View
+// sizes are rounded up to the allocation granularity; 0 maps the whole file.
+// Each pass runs on its own thread so an in-page error on a mapped view can
+// end that pass and be reported as a failure instead of ending the process.
+void BenchmarkMappedIo(const std::wstring& dir, const BenchmarkOptions& options) {
+    ULONGLONG fileSize = GetBenchmarkSize(options, L"file-size", 1ULL << 30);
+    DWORD blockSize = (DWORD)GetBenchmarkSize(options, L"block-size", 4 << 10);
+    ULONGLONG randomOps = GetBenchmarkCount(options, L"random-ops", 100000);
+    std::vector<ULONGLONG> viewSizes =
+        GetBenchmarkSizeList(options, L"view-sizes", { 64 << 10, 1 << 20, 16 << 20, 256 << 20 });
+    std::vector<ULONGLONG> flushIntervals = GetBenchmarkSizeList(options, L"flush-every", { 0, 1, 64, 4096 });
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    ULONGLONG granularity = si.dwAllocationGranularity;
+    if (blockSize == 0 || granularity % blockSize != 0 || fileSize < blockSize) {
+        LogFailure(L"MapViewOfFile", L"--block-size must divide the " + FormatSize(granularity) +
+                                     L" allocation granularity and fit in --file-size");
+        return;
+    }
+    fileSize -= fileSize % blockSize;
+
+    std::wstring path = dir + L"\\Mapped.bin";
+    if (!CreateFilledFile(path, fileSize)) {
+        LogFailure(L"WriteFile", L"Failed to preallocate " + path + L". Error: " + std::to_wstring(GetLastError()));
+        return;
+    }
+    std::vector<BYTE> block(blockSize);
+    std::mt19937_64 generator(12345);
+    PVOID faultHandler = AddVectoredExceptionHandler(1, MappedIoFaultHandler);
+
+    for (int write = 0; write < 2; ++write) {
+        for (int random = 0; random < 2; ++random) {
+            std::vector<MappedIoPass> passes = { { write != 0, random != 0, 0, 0 } };
+            for (ULONGLONG viewSize : viewSizes) {
+                viewSize = viewSize == 0 ? fileSize : (viewSize + granularity - 1) / granularity * granularity;
+                if (!write)
+                    passes.push_back({ false, random != 0, viewSize, 0 });
+                for (ULONGLONG flushEvery : flushIntervals)
+                    if (write)
+                        passes.push_back({ true, random != 0, viewSize, flushEvery });
+            }
+
+            for (const auto& pass : passes) {
+                std::wstring label = pass.viewSize == 0 ? std::wstring(write ? L"WriteFile" : L"ReadFile")
+                                                        : L"MapViewOfFile View=" + FormatSize(pass.viewSize);
+                label += random ? L" Random" : L" Sequential";
+                if (pass.viewSize != 0 && write)
+                    label += L" FlushEvery=" + (pass.flushEvery ? std::to_wstring(pass.flushEvery) : L"never");
+
+                MappedIoRun run;
+                run.path = &path;
+                run.fileSize = fileSize;
+                run.blockSize = blockSize;
+                run.ops = random ? randomOps : fileSize / blockSize;
+                run.pass = pass;
+                run.block = &block;
+                run.generator = &generator;
+
+                g_mappedIoFaultStatus = 0;
+                double cpuStart = ProcessCpuSeconds();
+                LONGLONG start = QueryCounter();
+                DWORD threadId = 0;
+                DWORD exitCode = 2;
+                HANDLE thread = CreateThread(nullptr, 0, MappedIoThread, &run, CREATE_SUSPENDED, &threadId);
+                if (thread == nullptr) {
+                    run.error = GetLastError();
+                } else {
+                    g_mappedIoThreadId = threadId;
+                    ResumeThread(thread);
+                    WaitForSingleObject(thread, INFINITE);
+                    GetExitCodeThread(thread, &exitCode);
+                    CloseHandle(thread);
+                    g_mappedIoThreadId = 0;
+                }
+                double seconds = CounterToSeconds(QueryCounter() - start);
+                CloseMappedIoRun(run);
+
+                if (exitCode == 1 && g_mappedIoFaultStatus != 0) {
+                    wchar_t fault[96];
+                    swprintf_s(fault, L" in-page error at file offset %llu. NTSTATUS: 0x%08lX",
+                               run.window.base + (g_mappedIoFaultAddress - (ULONG_PTR)run.window.view),
+                               (unsigned long)g_mappedIoFaultStatus);
+                    LogFailure(L"MapViewOfFile", label + fault);
+                    continue;
+                }
+                if (exitCode != 0) {
+                    LogFailure(pass.viewSize ? L"MapViewOfFile" : (write ? L"WriteFile" : L"ReadFile"),
+                               label + L" failed. Error: " + std::to_wstring(run.error));
+                    continue;
+                }
+
+                PrintThroughput(label, run.ops * blockSize, seconds, ProcessCpuSeconds() - cpuStart);
+                if (random)
+                    PrintLatency(label, run.latency);
+                if (pass.viewSize != 0)
+                    std::wcout << L"[BENCH] " << label << L": " << run.window.remaps << L" views mapped" << std::endl;
+            }
+        }
+    }
+    if (faultHandler != nullptr)
+        RemoveVectoredExceptionHandler(faultHandler);
+    DeleteFileW(path.c_str());
+}
+
+// Harness
+
+typedef void (*TestFunction)(const std::wstring& dir);
+
+// Every test runs in its own sandbox directory, so name collisions are not a
+// concern. Tests flagged TEST_EXCLUSIVE observe volume-wide state instead and
+// the scheduler never runs them alongside other tests.
+#define TEST_PARALLEL  0x0
+#define TEST_EXCLUSIVE 0x1
+
+struct TestCase {
+    const wchar_t* group;
+    const wchar_t* name;
+    TestFunction function;
+    DWORD flags;
+};
+
+#define TEST_CASE(group, function, flags) { group, L ## #function, function, flags }
+
+static const TestCase g_tests[] = {
+    // --- FILE CREATION ---
+    TEST_CASE(L"FILE CREATION", CreateFileWCreateAlways, TEST_PARALLEL),
+    TEST_CASE(L"FILE CREATION", CreateFileWCreateNew, TEST_PARALLEL),
+    TEST_CASE(L"FILE CREATION", CreateFileWTruncateExisting, TEST_PARALLEL),
+    TEST_CASE(L"FILE CREATION", CreateFileWOpenExisting, TEST_PARALLEL),
+    TEST_CASE(L"FILE CREATION", CreateFileWOpenAlways, TEST_PARALLEL),
+    TEST_CASE(L"FILE CREATION", CreateFileWReadWriteAccess, TEST_PARALLEL),
+
+    // --- SYMBOLIC LINKS ---
+    TEST_CASE(L"SYMBOLIC LINKS", CreateSymbolicLinkWFileLink, TEST_PARALLEL),
+    TEST_CASE(L"SYMBOLIC LINKS", CreateSymbolicLinkWDirectoryLink, TEST_PARALLEL),
+
+    // --- HARD LINKS ---
+    TEST_CASE(L"HARD LINKS", CreateHardLinkWBasic, TEST_PARALLEL),
+    TEST_CASE(L"HARD LINKS", CreateHardLinkWTargetMissing, TEST_PARALLEL),
+    TEST_CASE(L"HARD LINKS", CreateHardLinkWAlreadyExists, TEST_PARALLEL),
+    TEST_CASE(L"HARD LINKS", CreateHardLinkWModifyLinkReflectsInOriginal, TEST_PARALLEL),
+
+    // --- DIRECTORY CREATION ---
+    TEST_CASE(L"DIRECTORY CREATION", CreateDirectoryWBasic, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY CREATION", CreateDirectoryWAlreadyExists, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY CREATION", CreateDirectoryWWithSubdirectories, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY CREATION", CreateDirectoryWInvalidPath, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY CREATION", CreateDirectoryWRelativePath, TEST_PARALLEL),
+
+    // --- FILE COPY ---
+    TEST_CASE(L"FILE COPY", CopyFileWBasicCopy, TEST_PARALLEL),
+    TEST_CASE(L"FILE COPY", CopyFileWFailIfExists, TEST_PARALLEL),
+    TEST_CASE(L"FILE COPY", CopyFileWOverwriteAllowed, TEST_PARALLEL),
+    TEST_CASE(L"FILE COPY", CopyFileWSourceMissing, TEST_PARALLEL),
+    TEST_CASE(L"FILE COPY", CopyFileWSubdirToParent, TEST_PARALLEL),
+    TEST_CASE(L"FILE COPY", CopyFileWParentToSubdir, TEST_PARALLEL),
+    TEST_CASE(L"FILE COPY", CopyFileWFromSymbolicLink, TEST_PARALLEL),
+
+    // --- FILE MOVE ---
+    TEST_CASE(L"FILE MOVE", MoveFileWRenameSameDirectory, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWIntoSubdirectory, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWDestinationExists, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWSymbolicLinkItself, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWFromSubdirectoryToParent, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWDirectoryMoveBasic, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWDirectoryRenameInPlace, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWDirectoryIntoSubdirectory, TEST_PARALLEL),
+    TEST_CASE(L"FILE MOVE", MoveFileWDirectoryOverwriteExisting, TEST_PARALLEL),
+
+    // --- FILE DELETE ---
+    TEST_CASE(L"FILE DELETE", DeleteFileWBasic, TEST_PARALLEL),
+    TEST_CASE(L"FILE DELETE", DeleteFileWNotExists, TEST_PARALLEL),
+    TEST_CASE(L"FILE DELETE", DeleteFileWReadOnlyFile, TEST_PARALLEL),
+    TEST_CASE(L"FILE DELETE", DeleteFileWOnDirectory, TEST_PARALLEL),
+    TEST_CASE(L"FILE DELETE", DeleteFileWRelativePath, TEST_PARALLEL),
+    TEST_CASE(L"FILE DELETE", DeleteFileWInSubdirectory, TEST_PARALLEL),
+
+    // --- DIRECTORY DELETE ---
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWBasic, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWNonEmpty, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWRelativePath, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWNotExist, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWWithTrailingSlash, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWHasSubdirectory, TEST_PARALLEL),
+    TEST_CASE(L"DIRECTORY DELETE", RemoveDirectoryWSubdirectoryOfParent, TEST_PARALLEL),
+
+    // --- FILE ATTRIBUTES ---
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWReadOnly, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWHidden, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWSystem, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWInvalidFile, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWClearAttributes, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWReadonlyBlocksWrite, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWHiddenHidesFromWildcard, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWNormalClearsOtherFlags, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWOnInvalidPathFails, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWDirectoryReadonly, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWDirectoryHidden, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWDirectorySystem, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWDirectoryNormalClearsOthers, TEST_PARALLEL),
+    TEST_CASE(L"FILE ATTRIBUTES", SetFileAttributesWDirectoryInvalidPathFails, TEST_PARALLEL),
+
+    // --- SET END OF FILE ---
+    TEST_CASE(L"SET END OF FILE", SetEndOfFileTruncate, TEST_PARALLEL),
+    TEST_CASE(L"SET END OF FILE", SetEndOfFileExtend, TEST_PARALLEL),
+    TEST_CASE(L"SET END OF FILE", SetEndOfFileAtExactSize, TEST_PARALLEL),
+    TEST_CASE(L"SET END OF FILE", SetEndOfFileInvalidHandle, TEST_PARALLEL),
+    TEST_CASE(L"SET END OF FILE", SetEndOfFileOnReadOnlyHandle, TEST_PARALLEL),
+
+    // --- FILE INFORMATION ---
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleDeleteFile, TEST_PARALLEL),
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleTruncateFile, TEST_PARALLEL),
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleDeleteReadOnlyFile, TEST_PARALLEL),
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleRenameFile, TEST_PARALLEL),
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleRenameOverwrite, TEST_PARALLEL),
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleRenameWithRoot, TEST_PARALLEL),
+    TEST_CASE(L"FILE INFORMATION", SetFileInformationByHandleChangeTimes, TEST_PARALLEL),
+
+    // --- FIND FILE ---
+    TEST_CASE(L"FIND FILE", FindFirstFileWExactMatch, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWWildcardMatch, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWExtensionMatch, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWNonexistentFails, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWHiddenFileVisibleByName, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWDirectoryExactMatch, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWDirectoryWildcard, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWDirectoryHiddenAttribute, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWDirectoryEnumerateSubdirs, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWDirectoryDotDot, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWRecursiveFiles, TEST_PARALLEL),
+    TEST_CASE(L"FIND FILE", FindFirstFileWRecursiveDirectories, TEST_PARALLEL),
+
+    // --- GET COMPRESSED FILE SIZE ---
+    TEST_CASE(L"GET COMPRESSED FILE SIZE", GetCompressedFileSizeWCompressedFile, TEST_PARALLEL),
+    TEST_CASE(L"GET COMPRESSED FILE SIZE", GetCompressedFileSizeWSparseFile, TEST_PARALLEL),
+
+    // --- DISK FREE SPACE ---
+    // Free-cluster deltas are only meaningful while nothing else writes.
+    TEST_CASE(L"DISK FREE SPACE", GetDiskFreeSpaceWBasic, TEST_EXCLUSIVE),
+    TEST_CASE(L"DISK FREE SPACE", GetDiskFreeSpaceWFileDeletionRestoresSpace, TEST_EXCLUSIVE),
+
+    // --- WRITE FILE ---
+    TEST_CASE(L"WRITE FILE", WriteFileBasic, TEST_PARALLEL),
+    TEST_CASE(L"WRITE FILE", WriteFileWithOffset, TEST_PARALLEL),
+    TEST_CASE(L"WRITE FILE", WriteFileBeyondEOF, TEST_PARALLEL),
+    TEST_CASE(L"WRITE FILE", WriteFileAppendMode, TEST_PARALLEL),
+    TEST_CASE(L"WRITE FILE", WriteFileToReadOnlyFile, TEST_PARALLEL),
+    TEST_CASE(L"WRITE FILE", WriteFileInvalidHandle, TEST_PARALLEL),
+
+    // --- READ FILE ---
+    TEST_CASE(L"READ FILE", ReadFileBasic, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFilePartial, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFileAtEOFReturnsZero, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFileClosedHandleFails, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFileInvalidHandleFails, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFileStart, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFileMiddle, TEST_PARALLEL),
+    TEST_CASE(L"READ FILE", ReadFileEnd, TEST_PARALLEL),
+
+    // --- LOCK FILE ---
+    TEST_CASE(L"LOCK FILE", LockFileBasicExclusive, TEST_PARALLEL),
+    TEST_CASE(L"LOCK FILE", LockFileInvalidHandle, TEST_PARALLEL),
+    TEST_CASE(L"LOCK FILE", LockFileNonOverlappingSuccess, TEST_PARALLEL),
+    TEST_CASE(L"LOCK FILE", LockFileAlreadyLockedFails, TEST_PARALLEL),
+    TEST_CASE(L"LOCK FILE", LockFileUnlockRegion, TEST_PARALLEL),
+
+    // --- UNLOCK FILE ---
+    TEST_CASE(L"UNLOCK FILE", UnlockFileBasic, TEST_PARALLEL),
+    TEST_CASE(L"UNLOCK FILE", UnlockFileWithoutLockFails, TEST_PARALLEL),
+    TEST_CASE(L"UNLOCK FILE", UnlockFileWrongRegionFails, TEST_PARALLEL),
+    TEST_CASE(L"UNLOCK FILE", UnlockFileWithInvalidHandle, TEST_PARALLEL),
+    TEST_CASE(L"UNLOCK FILE", UnlockFilePartialUnlockThenAccess, TEST_PARALLEL),
+};
+
+typedef void (*BenchmarkFunction)(const std::wstring& dir, const BenchmarkOptions& options);
+
+struct BenchmarkCase {
+    const wchar_t* name;
+    BenchmarkFunction function;
+    const wchar_t* description;
+    const wchar_t* options;  // Accepted --name N|SIZE|LIST pairs with their defaults
+};
+
+static const BenchmarkCase g_benchmarks[] = {
+    { L"open-latency", BenchmarkCreateFileWOpenLatency,
+      L"CreateFileW/CloseHandle latency per creation disposition and access mask",
+      L"--iterations N (100000)" },
+    { L"sequential", BenchmarkSequentialThroughput,
+      L"Sequential WriteFile/ReadFile MB/s and CPU per byte across block sizes and buffering flags",
+      L"--file-size SIZE (2G) --block-sizes LIST (4K,16K,64K,256K,1M,4M,8M)" },
+    { L"random-iops", BenchmarkRandomIops,
+      L"Random overlapped ReadFile/WriteFile IOPS and latency per block size and queue depth",
+      L"--file-size SIZE (1G) --seconds N (5) --threads N (2) --block-sizes LIST (4K,16K,64K)\n"
+      L"      --queue-depths LIST (1,4,16,64,256)" },
+    { L"metadata-storm", BenchmarkMetadataStorm,
+      L"Create/stat/delete ops/s and latency of tiny files from N threads, with thread-scaling efficiency",
+      L"--files N per thread (10000) --file-size SIZE (0) --threads LIST (1,2,4,8,16)" },
+    { L"enumerate", BenchmarkDirectoryEnumeration,
+      L"Entries/s of FindFirstFileW, FindFirstFileExW large fetch and FileIdBothDirectoryInfo by directory size",
+      L"--entries LIST (1000,10000,100000) --passes N (3) --buffer-size SIZE (64K) --populate-threads N (8)" },
+    { L"tree-walk", BenchmarkTreeWalk,
+      L"Files/s of the parallel work-stealing tree walker on wide and deep trees, and parallel cleanup",
+      L"--width N (1000) --depth N (10) --files N per directory (10) --threads LIST (1,2,4,8,16)" },
+    { L"copy", BenchmarkCopy,
+      L"MB/s and time to first byte of CopyFileW, CopyFileExW, CopyFile2 and a pipelined overlapped copy",
+      L"--sizes LIST (1M,64M,1G) --chunk-sizes LIST (64K,1M,8M) --pipeline-chunk SIZE (1M)" },
+    { L"rename", BenchmarkRename,
+      L"Renames/s of MoveFileW, MoveFileExW and FILE_RENAME_INFO, and directory move time by child count",
+      L"--files N (2000) --tree-depth N (16) --moves N (5) --children LIST (0,10,100,1000,10000,100000)" },
+    { L"locks", BenchmarkLocks,
+      L"LockFileEx scaling over private ranges, cost versus lock table size, and contended latency and fairness",
+      L"--iterations N per thread (10000) --table-size N (100000) --seconds N (5) --hold-us N (10)\n"
+      L"      --threads LIST (1,2,4,8,16)" },
+    { L"preallocate", BenchmarkPreallocation,
+      L"Growth by appends, SetEndOfFile and FileAllocationInfo, then sequential and random write throughput",
+      L"--file-size SIZE (1G) --block-size SIZE (1M) --random-block SIZE (4K) --random-writes N (20000)" },
+    { L"hard-links", BenchmarkHardLinks,
+      L"CreateHardLinkW and DeleteFileW latency by link count up to 1023, name enumeration cost, link count checks",
+      L"--files N (10) --links N (1023) --band N links per latency band (128)" },
+    { L"symlinks", BenchmarkSymlinkChains,
+      L"Open latency through symlink chains and directory symlink hops, and the depth where resolution fails",
+      L"--iterations N per depth (1000) --max-depth N (40) --max-hops N (31)" },
+    { L"attributes", BenchmarkAttributes,
+      L"Attribute and timestamp update rates: SetFileAttributesW vs SetFileInformationByHandle(FileBasicInfo)",
+      L"--files N per thread (100) --updates N per thread (20000) --threads LIST (1,4,16)" },
+    { L"delete", BenchmarkDelete,
+      L"Delete rates for DeleteFileW, FileDispositionInfo(Ex) and delete-on-close, and how long names linger",
+      L"--files N (10000) --linger-files N (200) --populate-threads N (8)" },
+    { L"space", BenchmarkSpace,
+      L"Write amplification of small, dense, compressed and sparse writes on the target volume",
+      L"--small-files N (1000) --small-size SIZE (100) --large-size SIZE (64M) --sparse-stride SIZE (1M)" },
+    { L"compression", BenchmarkCompression,
+      L"NTFS compression write/read MB/s and on-disk ratio across data entropy levels",
+      L"--file-size SIZE (256M) --block-size SIZE (1M) --entropy LIST of random byte percentages (0,25,50,75,100)" },
+    { L"sparse", BenchmarkSparse,
+      L"Sparse extent writes, FSCTL_SET_ZERO_DATA and FSCTL_QUERY_ALLOCATED_RANGES as extents grow; reads over holes",
+      L"--extents LIST (1000,10000,100000) --chunk SIZE (64K) --punches N per step (1000) --range-batch N (4096)\n"
+      L"      --read-size SIZE (256M)" },
+    { L"mapped-io", BenchmarkMappedIo,
+      L"MapViewOfFile reads and updates vs ReadFile/WriteFile, sequential and random, by view size and flush rate",
+      L"--file-size SIZE (1G) --block-size SIZE (4K) --random-ops N (100000) --view-sizes LIST (64K,1M,16M,256M)\n"
+      L"      --flush-every LIST of updates per FlushViewOfFile, 0 never (0,1,64,4096)" },
+};
+
+struct RunnerOptions {
+    std::wstring root;
+    DWORD jobs = 0;  // 0 = one worker per logical processor
+    DWORD settleTimeoutMsec = SETTLE_TIMEOUT_MSEC;
+    DWORD testTimeoutMsec = TEST_TIMEOUT_MSEC;
+    bool keepSandboxes = false;
+    DWORD shardIndex = 1;  // 1-based, see --shard
+    DWORD shardCount = 1;
+    std::wstring resultsPath;
+    DWORD repeat = 1;
+    bool shuffle = false;
+    bool seedGiven = false;
+    DWORD seed = 0;
+};
+
+static bool g_keepSandboxes = false;
+
+// Names the per-run directory under the target root. Host name, process id
+// and start time keep runners on several clients sharing one root apart.
+std::wstring MakeRunDirectoryName() {
+    wchar_t host[64] = L"host";
+    DWORD hostLength = _countof(host);
+    GetComputerNameW(host, &hostLength);
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    ULONGLONG stamp = ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime;
+
+    return L"libfs-" + std::wstring(host) + L"-" + std::to_wstring(GetCurrentProcessId()) + L"-" +
+           std::to_wstring(stamp);
+}
+
+void PrintTestResult(const TestResult& result) {
+    AcquireSRWLockExclusive(&g_consoleLock);
+    for (const auto& line : result.lines) {
+        if (line.success)
+            std::wcout << line.text << std::endl;
+        else
+            std::wcerr << line.text << std::endl;
+    }
+    std::wstring status = (result.timedOut ? L"[TIMEOUT] " : result.failures == 0 ? L"[PASSED] " : L"[FAILED] ") +
+                          result.name +
+                          L" (" + std::to_wstring((long long)(result.seconds * 1000.0)) + L" ms, settle " +
+                          std::to_wstring((long long)(result.settleSeconds * 1000.0)) + L" ms";
+    if (result.settleTimeouts != 0)
+        status += L", " + std::to_wstring(result.settleTimeouts) + L" settle timeouts";
+    status += L")";
+    if (result.failures == 0)
+        std::wcout << status << std::endl;
+    else
+        std::wcerr << status << std::endl;
+    ReleaseSRWLockExclusive(&g_consoleLock);
+}
+
+// Runs one test inside a fresh sandbox directory under runDir and removes the
+// sandbox afterwards unless --keep-sandboxes was given. The worker prints the
+// result once it knows the watchdog has not given up on the test.
+void RunTest(const TestCase& test, const std::wstring& runDir, TestResult& result) {
+    result.name = test.name;
+
+    std::wstring sandbox = runDir + L"\\" + test.name;
+    if (!CreateDirectoryW(sandbox.c_str(), nullptr)) {
+        result.lines.push_back({ false, L"[FAIL] " + result.name + L": Failed to create sandbox " + sandbox +
+                                        L". Error: " + std::to_wstring(GetLastError()) });
+        result.failures++;
+        return;
+    }
+
+    g_currentResult = &result;
+    LONGLONG start = QueryCounter();
+    test.function(sandbox);
+    result.seconds = CounterToSeconds(QueryCounter() - start);
+    g_currentResult = nullptr;
+
+    if (!g_keepSandboxes)
+        RemoveDirectoryTree(sandbox);
+
+    if (result.successes == 0 && result.failures == 0) {
+        result.lines.push_back({ false, L"[FAIL] " + result.name + L": Test reported no outcome" });
+        result.failures++;
+    }
+}
+
+// Unwind table (.pdata) of one loaded module, recorded before a thread is
+// suspended so the stack walk never needs the loader.
+struct UnwindModule {
+    DWORD64 base;
+    DWORD64 end;
+    const RUNTIME_FUNCTION* functions;
+    DWORD count;
+};
+
+// Snapshots the unwind tables of every module in the process. Must run before
+// SuspendThread: module enumeration takes the loader lock.
+std::vector<UnwindModule> SnapshotUnwindModules() {
+    std::vector<UnwindModule> modules;
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetCurrentProcessId());
+    if (snapshot == INVALID_HANDLE_VALUE)
+        return modules;
+    MODULEENTRY32W entry = {};
+    entry.dwSize = sizeof(entry);
+    for (BOOL more = Module32FirstW(snapshot, &entry); more; more = Module32NextW(snapshot, &entry)) {
+        const BYTE* base = entry.modBaseAddr;
+        const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)base;
+        const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)(base + dos->e_lfanew);
+        if (dos->e_magic != IMAGE_DOS_SIGNATURE || nt->Signature != IMAGE_NT_SIGNATURE)
+            continue;
+        const IMAGE_DATA_DIRECTORY& dir = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+        if (dir.VirtualAddress == 0 || dir.Size < sizeof(RUNTIME_FUNCTION))
+            continue;
+        modules.push_back({ (DWORD64)(ULONG_PTR)base, (DWORD64)(ULONG_PTR)base + entry.modBaseSize,
+                            (const RUNTIME_FUNCTION*)(base + dir.VirtualAddress),
+                            (DWORD)(dir.Size / sizeof(RUNTIME_FUNCTION)) });
+    }
+    CloseHandle(snapshot);
+    return modules;
+}
+
+// Binary search of the snapshotted .pdata tables; entries are sorted by
+// BeginAddress. Returns nullptr for leaf functions and code outside any module.
+const RUNTIME_FUNCTION* FindUnwindEntry(const std::vector<UnwindModule>& modules, DWORD64 address,
+                                        DWORD64& imageBase) {
+    for (const auto& module : modules) {
+        if (address < module.base || address >= module.end)
+            continue;
+        DWORD rva = (DWORD)(address - module.base);
+        DWORD low = 0, high = module.count;
+        while (low < high) {
+            DWORD mid = low + (high - low) / 2;
+            if (rva < module.functions[mid].BeginAddress)
+                high = mid;
+            else if (rva >= module.functions[mid].EndAddress)
+                low = mid + 1;
+            else {
+                imageBase = module.base;
+                return &module.functions[mid];
+            }
+        }
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// Walks the stack of a suspended thread and stores up to `max` return
+// addresses, innermost first. Runs while the thread is suspended, so it must
+// not allocate or take any lock the thread might hold: the heap lock, the
+// loader lock or the dynamic function table lock behind
+// RtlLookupFunctionEntry. Function entries therefore come from `modules`,
+// snapshotted beforehand, and only RtlVirtualUnwind, which just decodes
+// unwind data, is called. Every stack read is bounded by the committed
+// stack region the thread's Rsp was in when it was suspended, and the walk
+// stops at the first frame that leaves it or goes backwards, so a corrupt
+// or half-built frame ends the trace instead of faulting the watchdog. Only
+// x64 has the unwind tables this relies on; elsewhere nothing is captured.
+size_t CaptureThreadStack(HANDLE thread, const std::vector<UnwindModule>& modules, DWORD64* frames, size_t max) {
+#if defined(_M_X64) || defined(__x86_64__)
+    CONTEXT context = {};
+    context.ContextFlags = CONTEXT_FULL;
+    if (!GetThreadContext(thread, &context))
+        return 0;
+
+    MEMORY_BASIC_INFORMATION stack = {};
+    if (VirtualQuery((LPCVOID)(ULONG_PTR)context.Rsp, &stack, sizeof(stack)) != sizeof(stack) ||
+        stack.State != MEM_COMMIT)
+        return 0;
+    DWORD64 stackLow = (DWORD64)(ULONG_PTR)stack.BaseAddress;
+    DWORD64 stackHigh = stackLow + stack.RegionSize;
+    const DWORD64 userLimit = 0x00007FFFFFFFFFFFULL;
+
+    size_t count = 0;
+    while (count < max && context.Rip != 0 && context.Rip <= userLimit) {
+        frames[count++] = context.Rip;
+        if (context.Rsp < stackLow || context.Rsp + sizeof(DWORD64) > stackHigh || context.Rsp % sizeof(DWORD64) != 0)
+            break;
+
+        DWORD64 previousRsp = context.Rsp;
+        DWORD64 imageBase = 0;
+        PRUNTIME_FUNCTION function = (PRUNTIME_FUNCTION)FindUnwindEntry(modules, context.Rip, imageBase);
+        if (function == nullptr) {
+            // Leaf function: the return address is on top of the stack.
+            context.Rip = *(DWORD64*)context.Rsp;
+            context.Rsp += sizeof(DWORD64);
+        } else {
+            PVOID handlerData = nullptr;
+            DWORD64 establisherFrame = 0;
+            RtlVirtualUnwind(UNW_FLAG_NHANDLER, imageBase, context.Rip, function, &context, &handlerData,
+                             &establisherFrame, nullptr);
+        }
+        if (context.Rsp <= previousRsp)
+            break;
+    }
+    return count;
+#else
+    return 0;
+#endif
+}
+
+// Names a code address as module!export using the nearest preceding export of
+// the module that contains it. Good enough for the system DLLs, which is where
+// a hung test is blocked.
+std::wstring DescribeCodeAddress(DWORD64 address) {
+    HMODULE module = nullptr;
+    if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                            (LPCWSTR)(ULONG_PTR)address, &module))
+        return L"unknown";
+
+    wchar_t path[MAX_PATH];
+    DWORD length = GetModuleFileNameW(module, path, MAX_PATH);
+    std::wstring moduleName(path, length);
+    size_t slash = moduleName.find_last_of(L"\\/");
+    if (slash != std::wstring::npos)
+        moduleName = moduleName.substr(slash + 1);
+
+    const BYTE* base = (const BYTE*)module;
+    const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)base;
+    const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)(base + dos->e_lfanew);
+    if (dos->e_magic != IMAGE_DOS_SIGNATURE || nt->Signature != IMAGE_NT_SIGNATURE)
+        return moduleName;
+    const IMAGE_DATA_DIRECTORY& dir = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    if (dir.VirtualAddress == 0)
+        return moduleName;
+
+    const IMAGE_EXPORT_DIRECTORY* exports = (const IMAGE_EXPORT_DIRECTORY*)(base + dir.VirtualAddress);
+    const DWORD* functions = (const DWORD*)(base + exports->AddressOfFunctions);
+    const DWORD* names = (const DWORD*)(base + exports->AddressOfNames);
+    const WORD* ordinals = (const WORD*)(base + exports->AddressOfNameOrdinals);
+    DWORD rva = (DWORD)(address - (DWORD64)(ULONG_PTR)base);
+
+    const char* best = nullptr;
+    DWORD bestRva = 0;
+    for (DWORD i = 0; i < exports->NumberOfNames; ++i) {
+        DWORD functionRva = functions[ordinals[i]];
+        bool forwarder = functionRva >= dir.VirtualAddress && functionRva < dir.VirtualAddress + dir.Size;
+        if (!forwarder && functionRva <= rva && functionRva >= bestRva) {
+            best = (const char*)(base + names[i]);
+            bestRva = functionRva;
+        }
+    }
+    if (best == nullptr)
+        return moduleName;
+    std::wstring exportName;
+    for (const char* c = best; *c != '\0'; ++c)
+        exportName += (wchar_t)*c;
+    return moduleName + L"!" + exportName;
+}
+
+// Names the API a hung worker is blocked in: the outermost frame outside this
+// executable before the stack returns into test code, plus the innermost frame
+// (usually the ntdll system call stub) when they differ.
+std::wstring DescribeBlockingCall(HANDLE thread) {
+    std::vector<UnwindModule> modules = SnapshotUnwindModules();
+    DWORD64 frames[HANG_CAPTURE_MAX_FRAMES];
+    size_t count = 0;
+    if (SuspendThread(thread) != (DWORD)-1) {
+        count = CaptureThreadStack(thread, modules, frames, HANG_CAPTURE_MAX_FRAMES);
+        ResumeThread(thread);
+    }
+
+    HMODULE self = GetModuleHandleW(nullptr);
+    size_t api = count;
+    for (size_t i = 0; i < count; ++i) {
+        HMODULE module = nullptr;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           (LPCWSTR)(ULONG_PTR)frames[i], &module);
+        if (module == self)
+            break;
+        api = i;
+    }
+    if (api == count)
+        return L"unknown";
+
+    std::wstring description = DescribeCodeAddress(frames[api]);
+    if (api != 0)
+        description += L" via " + DescribeCodeAddress(frames[0]);
+    return description;
+}
+
+// A run of tests that may execute concurrently. Workers claim the next
+// unstarted index until the batch is drained; `progress` is signaled whenever
+// a worker finishes a test or exits so the watchdog can re-check deadlines.
+struct TestBatch {
+    const std::wstring* dir;
+    const TestCase* const* tests;
+    TestResult* results;
+    LONG count;
+    LONG volatile next;
+    HANDLE progress;
+};
+
+// State shared between a worker thread and the watchdog. Once the watchdog
+// abandons a worker it never touches it again and the object is leaked: the
+// hung thread may wake up at any time and must still find it valid.
+struct TestWorker {
+    TestBatch* batch = nullptr;
+    HANDLE thread = nullptr;
+    SRWLOCK lock = SRWLOCK_INIT;
+    LONG index = -1;          // Test being run, -1 while between tests
+    LONGLONG started = 0;
+    bool abandoned = false;
+};
+
+static DWORD g_testTimeoutMsec = TEST_TIMEOUT_MSEC;
+
+static DWORD WINAPI TestWorkerThread(LPVOID param) {
+    TestWorker* worker = static_cast<TestWorker*>(param);
+    TestBatch* batch = worker->batch;
+    for (;;) {
+        LONG index = InterlockedIncrement(&batch->next) - 1;
+        if (index >= batch->count)
+            break;
+
+        AcquireSRWLockExclusive(&worker->lock);
+        worker->index = index;
+        worker->started = QueryCounter();
+        ReleaseSRWLockExclusive(&worker->lock);
+        // Wake the watchdog so it arms a deadline for this test.
+        SetEvent(batch->progress);
+
+        TestResult result;
+        RunTest(*batch->tests[index], *batch->dir, result);
+
+        AcquireSRWLockExclusive(&worker->lock);
+        bool abandoned = worker->abandoned;
+        worker->index = -1;
+        ReleaseSRWLockExclusive(&worker->lock);
+
+        // The watchdog already reported this test, and the batch may be gone.
+        if (abandoned)
+            return 0;
+
+        batch->results[index] = result;
+        PrintTestResult(batch->results[index]);
+        SetEvent(batch->progress);
+    }
+    SetEvent(batch->progress);
+    return 0;
+}
+
+TestWorker* StartTestWorker(TestBatch& batch) {
+    TestWorker* worker = new TestWorker();
+    worker->batch = &batch;
+    worker->thread = CreateThread(nullptr, 0, TestWorkerThread, worker, 0, nullptr);
+    if (worker->thread == nullptr) {
+        delete worker;
+        return nullptr;
+    }
+    return worker;
+}
+
+// Reports the test a hung worker is running as TIMEOUT, names the call it is
+// blocked in, and asks the system to cancel that call. The worker itself is
+// left to finish or hang on its own.
+void AbandonTestWorker(TestWorker* worker, LONG index, double seconds) {
+    TestBatch& batch = *worker->batch;
+    TestResult& result = batch.results[index];
+    result.name = batch.tests[index]->name;
+    result.seconds = seconds;
+    result.timedOut = true;
+    result.failures = 1;
+    result.lines.push_back({ false, L"[FAIL] " + result.name + L": Timed out after " +
+                                    std::to_wstring((long long)(seconds * 1000.0)) + L" ms, blocked in " +
+                                    DescribeBlockingCall(worker->thread) });
+    PrintTestResult(result);
+
+    CancelSynchronousIo(worker->thread);
+    CloseHandle(worker->thread);
+}
+
+// Runs the batch on up to `jobs` worker threads while the calling thread acts
+// as watchdog. A worker whose test exceeds g_testTimeoutMsec is abandoned and
+// replaced by a fresh one so the rest of the batch still runs.
+void RunBatch(TestBatch& batch, DWORD jobs) {
+    batch.progress = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+    std::vector<TestWorker*> workers;
+    DWORD count = std::max<DWORD>(1, std::min<DWORD>(jobs, (DWORD)batch.count));
+    for (DWORD i = 0; i < count; ++i) {
+        TestWorker* worker = StartTestWorker(batch);
+        if (worker != nullptr)
+            workers.push_back(worker);
+    }
+    if (workers.empty()) {
+        // Out of threads: fall back to running the batch inline, unguarded.
+        TestWorker inlineWorker;
+        inlineWorker.batch = &batch;
+        TestWorkerThread(&inlineWorker);
+    }
+
+    while (!workers.empty()) {
+        // Never sleep past one timeout, even if no worker has a test yet.
+        DWORD wait = g_testTimeoutMsec != 0 ? g_testTimeoutMsec : INFINITE;
+        LONGLONG now = QueryCounter();
+        for (size_t i = 0; i < workers.size();) {
+            TestWorker* worker = workers[i];
+            if (WaitForSingleObject(worker->thread, 0) == WAIT_OBJECT_0) {
+                CloseHandle(worker->thread);
+                delete worker;
+                workers.erase(workers.begin() + i);
+                continue;
+            }
+
+            LONG index = -1;
+            double elapsed = 0.0;
+            AcquireSRWLockExclusive(&worker->lock);
+            if (worker->index >= 0 && g_testTimeoutMsec != 0) {
+                elapsed = CounterToSeconds(now - worker->started);
+                if (elapsed * 1000.0 >= g_testTimeoutMsec) {
+                    worker->abandoned = true;
+                    index = worker->index;
+                } else {
+                    wait = std::min<DWORD>(wait, (DWORD)(g_testTimeoutMsec - elapsed * 1000.0) + 1);
+                }
+            }
+            ReleaseSRWLockExclusive(&worker->lock);
+
+            if (index < 0) {
+                ++i;
+                continue;
+            }
+
+            AbandonTestWorker(worker, index, elapsed);
+            workers.erase(workers.begin() + i);
+            if (batch.next < batch.count) {
+                TestWorker* replacement = StartTestWorker(batch);
+                if (replacement != nullptr)
+                    workers.push_back(replacement);
+            }
+        }
+
+        if (!workers.empty())
+            WaitForSingleObject(batch.progress, wait);
+    }
+
+    CloseHandle(batch.progress);
+}
+
+// Runs the tests in order on up to `jobs` workers. Consecutive parallel tests
+// form a batch; an exclusive test waits for the batch before it and runs alone.
+void RunTests(const std::vector<const TestCase*>& tests, const std::wstring& dir, DWORD jobs,
+              std::vector<TestResult>& results) {
+    results.assign(tests.size(), TestResult());
+
+    size_t begin = 0;
+    while (begin < tests.size()) {
+        size_t end = begin;
+        if (tests[begin]->flags & TEST_EXCLUSIVE) {
+            end = begin + 1;
+        } else {
+            while (end < tests.size() && !(tests[end]->flags & TEST_EXCLUSIVE))
+                ++end;
+        }
+
+        TestBatch batch = { &dir, &tests[begin], &results[begin], (LONG)(end - begin), 0, nullptr };
+        RunBatch(batch, (tests[begin]->flags & TEST_EXCLUSIVE) ? 1 : jobs);
+        begin = end;
+    }
+}
+
+void PrintSummary(const std::vector<TestResult>& results, DWORD jobs, double seconds) {
+    size_t failed = 0, timedOut = 0;
+    double settleSeconds = 0.0, maxSettleSeconds = 0.0;
+    for (const auto& r : results) {
+        if (r.failures != 0) ++failed;
+        if (r.timedOut) ++timedOut;
+        settleSeconds += r.settleSeconds;
+        maxSettleSeconds = std::max(maxSettleSeconds, r.settleSeconds);
+    }
+
+    std::wcout << L"[SUMMARY] " << results.size() << L" tests, " << (results.size() - failed) << L" passed, "
+               << failed << L" failed (" << timedOut << L" timed out) in " << seconds << L" s on " << jobs
+               << L" workers" << std::endl;
+    std::wcout << L"[SUMMARY] Settle time " << (long long)(settleSeconds * 1000.0) << L" ms total, "
+               << (long long)(maxSettleSeconds * 1000.0) << L" ms worst test" << std::endl;
+    for (const auto& r : results)
+        if (r.failures != 0)
+            std::wcerr << (r.timedOut ? L"[TIMEOUT] " : L"[FAILED] ") << r.name << std::endl;
+}
+
+// Reorders the tests with a Fisher-Yates shuffle driven by mt19937, whose
+// output is fully specified, so a seed reproduces the same order on any build.
+void ShuffleTests(std::vector<const TestCase*>& tests, std::mt19937& rng) {
+    for (size_t i = tests.size(); i > 1; --i)
+        std::swap(tests[i - 1], tests[rng() % i]);
+}
+
+// Prints pass rate and min/median/max duration per test across all
+// iterations of a --repeat run, in registry order.
+void PrintRepeatStatistics(const std::vector<TestResult>& results) {
+    for (const auto& test : g_tests) {
+        std::vector<double> durations;
+        size_t passed = 0;
+        for (const auto& r : results) {
+            if (r.name != test.name)
+                continue;
+            durations.push_back(r.seconds);
+            if (r.failures == 0)
+                ++passed;
+        }
+        if (durations.empty())
+            continue;
+
+        std::sort(durations.begin(), durations.end());
+        size_t n = durations.size();
+        double median = (n % 2) ? durations[n / 2] : (durations[n / 2 - 1] + durations[n / 2]) / 2.0;
+        std::wstring line = L"[REPEAT] " + std::wstring(test.name) + L": " + std::to_wstring(passed) + L"/" +
+                            std::to_wstring(n) + L" passed (" + std::to_wstring(passed * 100 / n) + L"%), min " +
+                            std::to_wstring((long long)(durations.front() * 1000.0)) + L" ms, median " +
+                            std::to_wstring((long long)(median * 1000.0)) + L" ms, max " +
+                            std::to_wstring((long long)(durations.back() * 1000.0)) + L" ms";
+        if (passed == n)
+            std::wcout << line << std::endl;
+        else
+            std::wcerr << line << std::endl;
+    }
+}
+
+// Result files let several runner processes, typically one per client machine,
+// each execute a shard and be combined afterwards with the merge subcommand.
+// They are UTF-8 text, one tab-separated record per line:
+//   libfs-results 2
+//   shard <i> <N>
+//   run <jobs> <seconds>
+//   test <name> <successes> <failures> <seconds> <settle seconds> <settle timeouts> <timed out>
+//   ok|fail <log line>      (belongs to the preceding test record)
+#define RESULT_FILE_MAGIC L"libfs-results"
+#define RESULT_FILE_VERSION 2
+
+struct ResultFile {
+    DWORD shardIndex = 1;
+    DWORD shardCount = 1;
+    DWORD jobs = 0;
+    double seconds = 0.0;
+    std::vector<TestResult> results;
+};
+
+// Keeps record fields intact when a log line happens to contain separators.
+std::wstring SanitizeResultField(const std::wstring& text) {
+    std::wstring clean = text;
+    for (auto& c : clean)
+        if (c == L'\t' || c == L'\r' || c == L'\n')
+            c = L' ';
+    return clean;
+}
+
+bool WriteResultFile(const std::wstring& path, const ResultFile& file) {
+    std::wstring text = std::wstring(RESULT_FILE_MAGIC) + L"\t" + std::to_wstring(RESULT_FILE_VERSION) + L"\n";
+    text += L"shard\t" + std::to_wstring(file.shardIndex) + L"\t" + std::to_wstring(file.shardCount) + L"\n";
+    text += L"run\t" + std::to_wstring(file.jobs) + L"\t" + std::to_wstring(file.seconds) + L"\n";
+    for (const auto& r : file.results) {
+        text += L"test\t" + SanitizeResultField(r.name) + L"\t" + std::to_wstring(r.successes) + L"\t" +
+                std::to_wstring(r.failures) + L"\t" + std::to_wstring(r.seconds) + L"\t" +
+                std::to_wstring(r.settleSeconds) + L"\t" + std::to_wstring(r.settleTimeouts) + L"\t" +
+                (r.timedOut ? L"1" : L"0") + L"\n";
+        for (const auto& line : r.lines)
+            text += (line.success ? L"ok\t" : L"fail\t") + SanitizeResultField(line.text) + L"\n";
+    }
+
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0, nullptr, nullptr);
+    std::string utf8(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &utf8[0], size, nullptr, nullptr);
+
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    DWORD written = 0;
+    BOOL ok = WriteFile(hFile, utf8.data(), (DWORD)utf8.size(), &written, nullptr) && written == utf8.size();
+    CloseHandle(hFile);
+    return ok != FALSE;
+}
+
+std::vector<std::wstring> SplitResultRecord(const std::wstring& line) {
+    std::vector<std::wstring> fields;
+    size_t begin = 0;
+    for (;;) {
+        size_t tab = line.find(L'\t', begin);
+        fields.push_back(line.substr(begin, tab == std::wstring::npos ? std::wstring::npos : tab - begin));
+        if (tab == std::wstring::npos)
+            return fields;
+        begin = tab + 1;
+    }
+}
+
+bool ReadResultFile(const std::wstring& path, ResultFile& file) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    std::string utf8;
+    DWORD read = 0;
+    BOOL ok = GetFileSizeEx(hFile, &size);
+    if (ok) {
+        utf8.resize((size_t)size.QuadPart);
+        ok = utf8.empty() || (ReadFile(hFile, &utf8[0], (DWORD)utf8.size(), &read, nullptr) && read == utf8.size());
+    }
+    CloseHandle(hFile);
+    if (!ok)
+        return false;
+
+    int length = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), nullptr, 0);
+    std::wstring text(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), &text[0], length);
+
+    bool sawHeader = false;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find(L'\n', begin);
+        if (end == std::wstring::npos)
+            end = text.size();
+        std::vector<std::wstring> f = SplitResultRecord(text.substr(begin, end - begin));
+        begin = end + 1;
+
+        if (!sawHeader) {
+            if (f.size() != 2 || f[0] != RESULT_FILE_MAGIC || _wtoi(f[1].c_str()) != RESULT_FILE_VERSION)
+                return false;
+            sawHeader = true;
+        } else if (f[0] == L"shard" && f.size() == 3) {
+            file.shardIndex = (DWORD)_wtoi(f[1].c_str());
+            file.shardCount = (DWORD)_wtoi(f[2].c_str());
+            if (file.shardIndex == 0 || file.shardCount == 0 || file.shardIndex > file.shardCount)
+                return false;
+        } else if (f[0] == L"run" && f.size() == 3) {
+            file.jobs = (DWORD)_wtoi(f[1].c_str());
+            file.seconds = _wtof(f[2].c_str());
+        } else if (f[0] == L"test" && f.size() == 8) {
+            TestResult r;
+            r.name = f[1];
+            r.successes = _wtoi(f[2].c_str());
+            r.failures = _wtoi(f[3].c_str());
+            r.seconds = _wtof(f[4].c_str());
+            r.settleSeconds = _wtof(f[5].c_str());
+            r.settleTimeouts = _wtoi(f[6].c_str());
+            r.timedOut = f[7] == L"1";
+            file.results.push_back(r);
+        } else if ((f[0] == L"ok" || f[0] == L"fail") && f.size() == 2 && !file.results.empty()) {
+            file.results.back().lines.push_back({ f[0] == L"ok", f[1] });
+        } else if (!(f.size() == 1 && f[0].empty())) {
+            return false;
+        }
+    }
+    return sawHeader;
+}
+
+// Keeps every shardCount-th registered test starting at shardIndex. The split
+// only depends on registry order, so every runner agrees on it without talking
+// to the others.
+std::vector<const TestCase*> SelectShard(const std::vector<const TestCase*>& tests, DWORD shardIndex,
+                                         DWORD shardCount) {
+    std::vector<const TestCase*> shard;
+    for (size_t i = 0; i < tests.size(); ++i)
+        if (i % shardCount == shardIndex - 1)
+            shard.push_back(tests[i]);
+    return shard;
+}
+
+// Combines the result files of a sharded run into one report, in registry
+// order, and lists registered tests that no shard reported.
+int MergeResultFiles(int argc, wchar_t* argv[]) {
+    std::vector<TestResult> merged;
+    DWORD jobs = 0;
+    double seconds = 0.0;
+    DWORD shardCount = 0;
+    std::map<DWORD, std::wstring> shards;  // Shard index to the file that supplied it
+
+    for (int i = 2; i < argc; ++i) {
+        ResultFile file;
+        if (!ReadResultFile(argv[i], file)) {
+            std::wcerr << L"Failed to read result file " << argv[i] << std::endl;
+            return 1;
+        }
+        std::wcout << L"[MERGE] " << argv[i] << L": shard " << file.shardIndex << L"/" << file.shardCount << L", "
+                   << file.results.size() << L" tests" << std::endl;
+        if (shardCount != 0 && file.shardCount != shardCount) {
+            std::wcerr << L"Shard count mismatch: " << argv[i] << L" is shard " << file.shardIndex << L"/"
+                       << file.shardCount << L" but earlier files are from a run split " << shardCount << L" ways"
+                       << std::endl;
+            return 1;
+        }
+        shardCount = file.shardCount;
+        auto duplicate = shards.find(file.shardIndex);
+        if (duplicate != shards.end()) {
+            std::wcerr << L"Duplicate shard " << file.shardIndex << L"/" << file.shardCount << L" in " << argv[i]
+                       << L" and " << duplicate->second << std::endl;
+            return 1;
+        }
+        shards[file.shardIndex] = argv[i];
+        jobs += file.jobs;
+        seconds = std::max(seconds, file.seconds);
+        merged.insert(merged.end(), file.results.begin(), file.results.end());
+    }
+
+    std::vector<TestResult> ordered;
+    std::vector<std::wstring> missing;
+    for (const auto& test : g_tests) {
+        bool found = false;
+        for (const auto& r : merged) {
+            if (r.name == test.name) {
+                ordered.push_back(r);
+                found = true;
+            }
+        }
+        if (!found)
+            missing.push_back(test.name);
+    }
+    for (const auto& r : merged) {
+        bool registered = false;
+        for (const auto& test : g_tests)
+            registered = registered || r.name == test.name;
+        if (!registered)
+            ordered.push_back(r);
+    }
+
+    for (const auto& r : ordered)
+        PrintTestResult(r);
+    if (ordered.size() > _countof(g_tests) - missing.size())
+        PrintRepeatStatistics(ordered);
+    PrintSummary(ordered, jobs, seconds);
+    DWORD missingShards = 0;
+    for (DWORD index = 1; index <= shardCount; ++index) {
+        if (shards.find(index) == shards.end()) {
+            std::wcerr << L"[MISSING] shard " << index << L"/" << shardCount << std::endl;
+            missingShards++;
+        }
+    }
+    for (const auto& name : missing)
+        std::wcerr << L"[MISSING] " << name << std::endl;
+    return missing.empty() && missingShards == 0 ? 0 : 1;
+}
+
+void PrintUsage() {
+    std::wcerr << L"Usage: tester.exe [--jobs N] [--settle-timeout MS] [--test-timeout MS] [--keep-sandboxes]\n"
+               << L"                  [--shard I/N] [--results FILE] [--repeat N] [--shuffle [--seed S]]\n"
+               << L"                  <target_root_path>\n"
+               << L"       tester.exe merge <results_file>...\n"
+               << L"       tester.exe bench <name> [--option value]... [--keep-sandboxes] <target_root_path>\n"
+               << L"  --jobs N              Run independent tests on N worker threads (default: processor count)\n"
+               << L"  --settle-timeout MS   Give up waiting on a post-condition after MS milliseconds (default: "
+               << SETTLE_TIMEOUT_MSEC << L")\n"
+               << L"  --test-timeout MS     Report a test as TIMEOUT after MS milliseconds, 0 to wait forever (default: "
+               << TEST_TIMEOUT_MSEC << L")\n"
+               << L"  --keep-sandboxes      Leave each test's sandbox directory in place for inspection\n"
+               << L"  --shard I/N           Run only the I-th of N deterministic slices of the test list\n"
+               << L"  --results FILE        Write the results to FILE for a later merge\n"
+               << L"  --repeat N            Run the test list N times and report per-test pass rate and durations\n"
+               << L"  --shuffle             Run the tests of every iteration in random order\n"
+               << L"  --seed S              Seed for --shuffle, to reproduce an earlier order (default: printed)\n"
+               << L"Benchmarks:\n";
+    for (const auto& benchmark : g_benchmarks)
+        std::wcerr << L"  " << benchmark.name << L"\n      " << benchmark.description << L"\n      "
+                   << benchmark.options << L"\n";
+}
+
+// Runs one benchmark in a sandbox under a fresh run directory. Results are
+// printed as [BENCH] lines by the benchmark itself.
+int RunBenchmarkCommand(int argc, wchar_t* argv[]) {
+    const BenchmarkCase* benchmark = nullptr;
+    for (const auto& candidate : g_benchmarks)
+        if (argc >= 3 && std::wstring(argv[2]) == candidate.name)
+            benchmark = &candidate;
+    if (benchmark == nullptr) {
+        PrintUsage();
+        return 1;
+    }
+
+    BenchmarkOptions options;
+    std::map<std::wstring, std::wstring> declared = GetDeclaredBenchmarkOptions(benchmark->options);
+    std::wstring root;
+    bool keepSandbox = false;
+    for (int i = 3; i < argc; ++i) {
+        std::wstring arg = argv[i];
+        if (arg == L"--keep-sandboxes") {
+            keepSandbox = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, L"--") == 0 && i + 1 < argc) {
+            auto option = declared.find(arg.substr(2));
+            if (option == declared.end()) {
+                std::wcerr << L"Unknown option " << arg << L" for benchmark " << benchmark->name << L". Accepts: "
+                           << benchmark->options << std::endl;
+                return 1;
+            }
+            std::wstring value = argv[++i];
+            if (!IsValidBenchmarkValue(option->second, value)) {
+                std::wcerr << L"Invalid value " << value << L" for " << arg << L": expected "
+                           << (option->second == L"N" ? L"a whole number"
+                               : option->second == L"SIZE" ? L"a size such as 64K"
+                                                           : L"a comma-separated list of sizes")
+                           << std::endl;
+                return 1;
+            }
+            options[option->first] = value;
+        } else if (root.empty() && !(arg.size() > 1 && arg[0] == L'-')) {
+            root = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (root.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    CreateDirectoryW(root.c_str(), nullptr); // Ensure test root exists
+    std::wstring runDir = root + L"\\" + MakeRunDirectoryName();
+    std::wstring sandbox = runDir + L"\\" + benchmark->name;
+    if (!CreateDirectoryW(runDir.c_str(), nullptr) || !CreateDirectoryW(sandbox.c_str(), nullptr)) {
+        std::wcerr << L"Failed to create sandbox " << sandbox << L". Error: " << GetLastError() << std::endl;
+        return 1;
+    }
+    std::wcout << L"[RUN] Benchmark " << benchmark->name << L" in " << sandbox << std::endl;
+
+    LONGLONG start = QueryCounter();
+    benchmark->function(sandbox, options);
+    std::wcout << L"[BENCH] " << benchmark->name << L" finished in " << CounterToSeconds(QueryCounter() - start)
+               << L" s" << std::endl;
+
+    if (!keepSandbox)
+        RemoveDirectoryTreeParallel(runDir, 8);
+    return 0;
+}
+
+// Parses a whole command-line value as a decimal DWORD. Unlike _wtoi, rejects
+// empty text, signs, spaces, trailing characters and overflow.
+bool ParseRunnerNumber(const std::wstring& text, DWORD& value) {
+    if (text.empty())
+        return false;
+    ULONGLONG parsed = 0;
+    for (wchar_t c : text) {
+        if (c < L'0' || c > L'9')
+            return false;
+        parsed = parsed * 10 + (c - L'0');
+        if (parsed > MAXDWORD)
+            return false;
+    }
+    value = (DWORD)parsed;
+    return true;
+}
+
+bool ParseRunnerOptions(int argc, wchar_t* argv[], RunnerOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::wstring arg = argv[i];
+        if (arg == L"--jobs" && i + 1 < argc) {
+            if (!ParseRunnerNumber(argv[++i], options.jobs) || options.jobs == 0)
+                return false;
+        } else if (arg == L"--settle-timeout" && i + 1 < argc) {
+            if (!ParseRunnerNumber(argv[++i], options.settleTimeoutMsec))
+                return false;
+        } else if (arg == L"--test-timeout" && i + 1 < argc) {
+            if (!ParseRunnerNumber(argv[++i], options.testTimeoutMsec))
+                return false;
+        } else if (arg == L"--keep-sandboxes") {
+            options.keepSandboxes = true;
+        } else if (arg == L"--shard" && i + 1 < argc) {
+            std::wstring shard = argv[++i];
+            size_t slash = shard.find(L'/');
+            DWORD index = 0, count = 0;
+            if (slash == std::wstring::npos || !ParseRunnerNumber(shard.substr(0, slash), index) ||
+                !ParseRunnerNumber(shard.substr(slash + 1), count) || index == 0 || index > count)
+                return false;
+            options.shardIndex = index;
+            options.shardCount = count;
+        } else if (arg == L"--results" && i + 1 < argc) {
+            options.resultsPath = argv[++i];
+        } else if (arg == L"--repeat" && i + 1 < argc) {
+            if (!ParseRunnerNumber(argv[++i], options.repeat) || options.repeat == 0)
+                return false;
+        } else if (arg == L"--shuffle") {
+            options.shuffle = true;
+        } else if (arg == L"--seed" && i + 1 < argc) {
+            if (!ParseRunnerNumber(argv[++i], options.seed))
+                return false;
+            options.seedGiven = true;
+        } else if (arg.size() > 1 && arg[0] == L'-') {
+            return false;
+        } else if (options.root.empty()) {
+            options.root = arg;
+        } else {
+            return false;
+        }
+    }
+
+    if (options.seedGiven && !options.shuffle) {
+        std::wcerr << L"--seed only applies together with --shuffle" << std::endl;
+        return false;
+    }
+    if (options.jobs == 0) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        options.jobs = std::max<DWORD>(1, si.dwNumberOfProcessors);
+    }
+    return !options.root.empty();
+}
+
+int wmain(int argc, wchar_t* argv[]) {
+    if (argc >= 2 && std::wstring(argv[1]) == L"merge") {
+        if (argc < 3) {
+            PrintUsage();
+            return 1;
+        }
+        return MergeResultFiles(argc, argv);
+    }
+    if (argc >= 2 && std::wstring(argv[1]) == L"bench")
+        return RunBenchmarkCommand(argc, argv);
+
+    RunnerOptions options;
+    if (!ParseRunnerOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    g_settleTimeoutMsec = options.settleTimeoutMsec;
+    g_testTimeoutMsec = options.testTimeoutMsec;
+    g_keepSandboxes = options.keepSandboxes;
+
+    CreateDirectoryW(options.root.c_str(), nullptr); // Ensure test root exists
+
+    std::wstring dir = options.root + L"\\" + MakeRunDirectoryName();
+    if (!CreateDirectoryW(dir.c_str(), nullptr)) {
+        std::wcerr << L"Failed to create run directory " << dir << L". Error: " << GetLastError() << std::endl;
+        return 1;
+    }
+    std::wcout << L"[RUN] Sandboxes under " << dir << std::endl;
+
+    std::vector<const TestCase*> tests;
+    for (const auto& test : g_tests)
+        tests.push_back(&test);
+    if (options.shardCount > 1) {
+        tests = SelectShard(tests, options.shardIndex, options.shardCount);
+        std::wcout << L"[RUN] Shard " << options.shardIndex << L"/" << options.shardCount << L": " << tests.size()
+                   << L" of " << _countof(g_tests) << L" tests" << std::endl;
+    }
+
+    if (options.shuffle && !options.seedGiven)
+        options.seed = GetTickCount();
+    if (options.shuffle)
+        std::wcout << L"[RUN] Shuffle seed " << options.seed << std::endl;
+    std::mt19937 rng(options.seed);
+
+    ResultFile file;
+    file.shardIndex = options.shardIndex;
+    file.shardCount = options.shardCount;
+    file.jobs = options.jobs;
+    LONGLONG start = QueryCounter();
+    for (DWORD iteration = 1; iteration <= options.repeat; ++iteration) {
+        // Each iteration gets its own directory so sandboxes never collide.
+        std::wstring iterationDir = dir;
+        if (options.repeat > 1) {
+            iterationDir += L"\\iteration-" + std::to_wstring(iteration);
+            CreateDirectoryW(iterationDir.c_str(), nullptr);
+            std::wcout << L"[RUN] Iteration " << iteration << L"/" << options.repeat << std::endl;
+        }
+        if (options.shuffle)
+            ShuffleTests(tests, rng);
+
+        std::vector<TestResult> results;
+        RunTests(tests, iterationDir, options.jobs, results);
+        file.results.insert(file.results.end(), results.begin(), results.end());
+    }
+    file.seconds = CounterToSeconds(QueryCounter() - start);
+    if (options.repeat > 1)
+        PrintRepeatStatistics(file.results);
+    PrintSummary(file.results, options.jobs, file.seconds);
+
+    if (!options.resultsPath.empty() && !WriteResultFile(options.resultsPath, file))
+        std::wcerr << L"Failed to write result file " << options.resultsPath << L". Error: " << GetLastError()
+                   << std::endl;
+
+    if (!g_keepSandboxes)
+        RemoveDirectoryTreeParallel(dir, options.jobs);
 
     return 0;
 }